@@ -0,0 +1,131 @@
+#! /bin/sh
+
+#===============================================================================
+# Benchmark for bresc: generates synthetic projects with genproject.pl, and
+# builds each of them as bres (.bli only), blc (blorb only) and bresc (both).
+# Each build writes a line of JSON: the time of each phase, bytes read and
+# written, throughput, peak memory and, if strace is available, the number
+# of system calls.
+#
+# The binary to measure must be given with -b: bin/ only holds old builds.
+#
+# Usage: benchmark.sh -b bresc [-n "10 1000 100000"] [-m max-size]
+#                     [-r runs] [-o results.jsonl] [-w work-dir]
+#-------------------------------------------------------------------------------
+
+bench_location=`dirname "$0"`
+bresc=
+sizes="10 1000"
+max_size=1048576
+runs=3
+output=
+work_dir=
+
+while getopts "b:n:m:r:o:w:" op; do
+	case $op in
+		b) bresc=$OPTARG;;
+		n) sizes=$OPTARG;;
+		m) max_size=$OPTARG;;
+		r) runs=$OPTARG;;
+		o) output=$OPTARG;;
+		w) work_dir=$OPTARG;;
+		*) sed -n 's/^# Usage: /Usage: /p;s/^#  \{16\}/                /p' "$0" >&2; exit 1;;
+	esac
+done
+
+if [ -z "$bresc" ]; then
+	echo "the bresc binary to measure must be given with -b" >&2
+	exit 1
+fi
+
+case $bresc in
+	/*) ;;
+	*) bresc=`pwd`/$bresc;;
+esac
+
+if [ ! -x "$bresc" ]; then
+	echo "bresc not found: '$bresc'" >&2
+	exit 1
+fi
+
+if [ -z "$work_dir" ]; then
+	work_dir=`mktemp -d "${TMPDIR:-/tmp}/bresc-bench.XXXXXX"` || exit 1
+	trap 'rm -rf "$work_dir"' 0
+fi
+
+if [ -n "$output" ]; then
+	exec > "$output"
+fi
+
+if ! command -v strace > /dev/null 2>&1; then
+	echo "strace not found: counts of system calls are skipped (null)" >&2
+fi
+
+# The mode of bresc depends on the name it is run with
+mkdir -p "$work_dir/bin"
+for mode in bres blc bresc; do
+	ln -sf "$bresc" "$work_dir/bin/$mode"
+done
+
+#-------------------------------------------------------------------------------
+
+# stat_field field: a number of the statistics, at the top level or in a phase
+stat_field() {
+	sed -n "s/^ *\"$1\": \([0-9.]*\),*\$/\1/p;s/^ *\"$1\": { \"wall\": \([0-9.]*\),.*/\1/p" "$work_dir/stats.json"
+}
+
+# count_syscalls mode: total of system calls of a build, or null without strace
+count_syscalls() {
+	if command -v strace > /dev/null 2>&1 \
+	&& strace -f -c -o "$work_dir/strace.txt" "$work_dir/bin/$1" game.res > /dev/null 2>&1
+	then
+		awk '/calls/ { for(i = 1; i <= NF; i++) if ( $i == "calls" ) col = i - 1 }
+		     / total$/ { print $col }' "$work_dir/strace.txt"
+	else
+		echo null
+	fi
+}
+
+for n in $sizes; do
+	for cover in false true; do
+		project=$work_dir/project-$n-$cover
+		extra=
+
+		if [ "$cover" = "true" ]; then
+			extra="--cover --biblio"
+		fi
+
+		rm -rf "$project"
+		perl "$bench_location/genproject.pl" --max-size="$max_size" $extra "$n" "$project" || exit 1
+		cd "$project" || exit 1
+
+		for mode in bres blc bresc; do
+			syscalls=`count_syscalls $mode`
+			run=1
+
+			while [ $run -le $runs ]; do
+				if ! "$work_dir/bin/$mode" --stats=json --stats-file "$work_dir/stats.json" game.res > "$work_dir/log.txt" 2>&1
+				then
+					echo "build failed: $mode, $n resources" >&2
+					cat "$work_dir/log.txt" >&2
+					exit 1
+				fi
+
+				echo "{\"resources\": $n, \"cover\": $cover, \"mode\": \"$mode\", \"run\": $run," \
+					 "\"wall\": `stat_field total`," \
+					 "\"phases\": { \"parse\": `stat_field parse`, \"load\": `stat_field load`," \
+					 "\"bli\": `stat_field bli`, \"index\": `stat_field index`, \"write\": `stat_field write` }," \
+					 "\"bytesRead\": `stat_field bytesRead`, \"bytesWritten\": `stat_field bytesWritten`," \
+					 "\"throughput\": `stat_field throughput`, \"peakMemoryKB\": `stat_field peakMemoryKB`," \
+					 "\"syscalls\": $syscalls}"
+
+				run=`expr $run + 1`
+			done
+		done
+
+		cd - > /dev/null
+		rm -rf "$project"
+	done
+done
+
+exit 0
@@ -0,0 +1,140 @@
+#!/usr/bin/perl
+
+#	File:		genproject.pl
+#
+#	Generates a synthetic bresc project, for benchmarking: a res file,
+#	a Glulx story file and N resources, mixing PNG and JPEG pictures and
+#	Ogg Vorbis, AIFF and MOD sounds. Sizes are spread on a logarithmic
+#	scale, from a few bytes to --max-size. Resources only have valid
+#	headers (the ones bresc checks), followed by filler bytes.
+#
+#	Usage: genproject.pl [options] N directory
+#		--max-size=BYTES	Largest resource (default: 1048576)
+#		--tiny				All resources of the smallest size of their type
+#		--cover				Adds a Cover entry
+#		--biblio			Adds a Biblio entry (ifiction file)
+#		--seed=N			Seed for sizes and types (default: 1)
+
+use strict;
+use warnings;
+use Getopt::Long;
+use File::Path qw( make_path );
+
+my $maxSize = 1024 * 1024;
+my $tiny = 0;
+my $withCover = 0;
+my $withBiblio = 0;
+my $seed = 1;
+my $blockSize = 64 * 1024;
+
+GetOptions(
+	'max-size=i' => \$maxSize,
+	'tiny'       => \$tiny,
+	'cover'      => \$withCover,
+	'biblio'     => \$withBiblio,
+	'seed=i'     => \$seed,
+) && @ARGV == 2 or die "Usage: $0 [--max-size=BYTES] [--tiny] [--cover] [--biblio] [--seed=N] N directory\n";
+
+my ( $numResources, $dir ) = @ARGV;
+
+srand( $seed );
+make_path( "$dir/res" );
+
+# The filler is the same for all files, but each file starts with a
+# different header, so they are not shared by deduplication
+my $filler = join( '', map { chr( int( rand( 256 ) ) ) } 1 .. $blockSize );
+
+# writeFile( name, header, size ): the header, and filler up to size bytes
+sub writeFile {
+	my ( $name, $header, $size ) = @_;
+	my $left = $size - length( $header );
+
+	open( my $f, '>:raw', $name ) or die "can't create '$name': $!\n";
+	print $f $header;
+
+	while ( $left > 0 ) {
+		my $len = ( $left < $blockSize ) ? $left : $blockSize;
+
+		print $f substr( $filler, 0, $len );
+		$left -= $len;
+	}
+
+	close( $f );
+}
+
+# Headers of each type, for a resource of a given size and number
+sub pngHeader {
+	my ( $size, $n ) = @_;
+	return "\x89PNG\r\n\x1a\n" . pack( 'N', 13 ) . 'IHDR'
+		 . pack( 'NNCCCCC', 1 + $n % 1024, 1 + $size % 768, 8, 6, 0, 0, 0 ) . pack( 'N', $n );
+}
+
+sub jpegHeader {
+	my ( $size, $n ) = @_;
+	return "\xFF\xD8" . "\xFF\xE0" . pack( 'n', 16 ) . "JFIF\0" . pack( 'CCCnnCC', 1, 1, 0, 1, 1, 0, 0 )
+		 . "\xFF\xC0" . pack( 'nCnnC', 17, 8, 1 + $size % 768, 1 + $n % 1024, 3 )
+		 . pack( 'CCC', 1, 0x22, 0 ) . pack( 'CCC', 2, 0x11, 1 ) . pack( 'CCC', 3, 0x11, 1 )
+		 . pack( 'N', $n );
+}
+
+sub oggHeader {
+	my ( $size, $n ) = @_;
+	return 'OggS' . pack( 'CC', 0, 2 ) . ( "\0" x 8 ) . pack( 'V', $n ) . pack( 'V', 0 ) . pack( 'V', 0 )
+		 . pack( 'C', 1 ) . pack( 'C', 30 )
+		 . "\x01vorbis" . pack( 'V', 0 ) . pack( 'C', 2 ) . pack( 'V', 44100 )
+		 . pack( 'VVV', 0, 128000, 0 ) . pack( 'C', 0xB8 ) . pack( 'C', 1 );
+}
+
+sub aiffHeader {
+	my ( $size, $n ) = @_;
+	return 'FORM' . pack( 'N', $size - 8 ) . 'AIFF'
+		 . 'COMM' . pack( 'N', 18 ) . pack( 'nNn', 2, $n, 16 ) . "\x40\x0E\xAC\x44" . ( "\0" x 6 );
+}
+
+sub modHeader {
+	my ( $size, $n ) = @_;
+	return sprintf( '%-20.20s', "bench $n" ) . ( "\0" x ( 1080 - 20 ) ) . 'M.K.';
+}
+
+my @types = (
+	# use, extension, header, minimum size
+	[ 'Pict',  'png', \&pngHeader,  64 ],
+	[ 'Pict',  'jpg', \&jpegHeader, 64 ],
+	[ 'Sound', 'ogg', \&oggHeader,  64 ],
+	[ 'Sound', 'aif', \&aiffHeader, 64 ],
+	[ 'Sound', 'mod', \&modHeader,  1100 ],
+);
+
+open( my $res, '>', "$dir/game.res" ) or die "can't create '$dir/game.res': $!\n";
+print $res "! Synthetic project: $numResources resources\n";
+print $res "Code game.ulx\n";
+
+writeFile( "$dir/game.ulx", 'Glul' . pack( 'N', 0x00030102 ), 64 * 1024 );
+
+if ( $withCover ) {
+	writeFile( "$dir/res/cover.png", pngHeader( 4096, 0 ), 4096 );
+	print $res "Cover res/cover.png\n";
+}
+
+for my $i ( 1 .. $numResources ) {
+	my ( $use, $ext, $header, $minSize ) = @{ $types[ int( rand( @types ) ) ] };
+	my $size = int( exp( log( $minSize ) + rand( log( $maxSize / $minSize ) ) ) );
+
+	$size = $minSize if $size < $minSize || $tiny;
+	writeFile( "$dir/res/r$i.$ext", $header->( $size, $i ), $size );
+	print $res "$use r$i res/r$i.$ext\n";
+}
+
+if ( $withBiblio ) {
+	make_path( "$dir/resources" );
+	open( my $bib, '>', "$dir/resources/game.ifiction" ) or die "can't create ifiction file: $!\n";
+	print $bib "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+			 . "<ifindex version=\"1.0\" xmlns=\"http://babel.ifarchive.org/protocol/iFiction/\">\n"
+			 . "<story><identification><format>glulx</format></identification>\n"
+			 . "<bibliographic><title>Benchmark</title><author>bresc</author></bibliographic>\n"
+			 . "</story></ifindex>\n";
+	close( $bib );
+	print $res "Biblio resources/game.ifiction\n";
+}
+
+close( $res );
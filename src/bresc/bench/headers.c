@@ -0,0 +1,203 @@
+/* headers.c
+ * Microbenchmark of the emission of chunk headers: writes the headers,
+ * the padding and the filler chunks of a blorb of many small chunks,
+ * as writeChunk() does, with an OutBuffer and with the fwrite() of one byte
+ * at a time of the former writeInt() and writeId(). The payloads are not
+ * written, so the cost of opening and copying resource files is left out.
+ *
+ * Usage: headers [chunks [runs]]
+ * Writes a line of JSON for each writer and run, to the standard output.
+ */
+
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/** Chunk header: id and length */
+#define ChunkHeaderLen 8
+
+/** Every how many chunks there is a filler chunk, as with --align */
+#define FillerEvery 16
+
+/** The ids of the chunks written, in turn */
+static const char * ChunkIds[] = { "PNG", "JPEG", "OGGV", "MOD", "GLUL", "AIFF" };
+
+/** The id of filler chunks */
+static const char * FillerId = "Fill";
+
+const char * getAppName()
+{
+    return "headers";
+}
+
+/**
+ * getLength returns the length of a small chunk, odd for half of them
+ * @param i The number of the chunk
+ */
+unsigned long getLength(unsigned long i)
+{
+    return 9 + ( i % 64 );
+}
+
+/**
+ * writeInt writes a 32bit big endian integer one byte at a time,
+ * as bresc did before OutBuffer
+ */
+void writeInt(FILE *f, unsigned int v)
+{
+    unsigned char v1 = v&0xFF;
+    unsigned char v2 = (v>>8)&0xFF;
+    unsigned char v3 = (v>>16)&0xFF;
+    unsigned char v4 = (v>>24)&0xFF;
+
+    fwrite( &v4, 1, 1, f );
+    fwrite( &v3, 1, 1, f );
+    fwrite( &v2, 1 ,1, f );
+    fwrite( &v1, 1 ,1 ,f );
+}
+
+/**
+ * writeId writes a 4 chars identifier, space padded, one byte at a time,
+ * as bresc did before OutBuffer
+ */
+void writeId(FILE *f, const char *s)
+{
+    size_t i;
+    static const char sp = ' ';
+
+    for (i = 0; i < strlen( s ); i++) {
+        fwrite( &s[ i ], 1, 1, f );
+    }
+
+    for (; i < 4; i++) {
+        fwrite( &sp, 1, 1, f );
+    }
+}
+
+/**
+ * writeHeadersBuffered writes all headers, padding and fillers with an OutBuffer
+ * @return the number of bytes written
+ */
+unsigned long long writeHeadersBuffered(FILE * f, unsigned long numChunks)
+{
+    static const char z = 0;
+    static const char zeros[ ChunkHeaderLen ] = { 0 };
+    unsigned long long toret = 0;
+    unsigned long i;
+    OutBuffer out;
+
+    outBufferInit( &out, f, 8192 );
+
+    for(i = 0; i < numChunks; i++) {
+        unsigned long length = getLength( i );
+
+        if ( i % FillerEvery == 0 ) {
+            outBufferWriteId( &out, FillerId );
+            outBufferWriteInt( &out, ChunkHeaderLen );
+            outBufferWrite( &out, zeros, ChunkHeaderLen );
+            toret += 2 * ChunkHeaderLen;
+        }
+
+        outBufferWriteId( &out, ChunkIds[ i % ( sizeof( ChunkIds ) / sizeof( ChunkIds[ 0 ] ) ) ] );
+        outBufferWriteInt( &out, length );
+        toret += ChunkHeaderLen;
+
+        if ( length % 2 ) {
+            outBufferWrite( &out, &z, 1 );
+            ++toret;
+        }
+    }
+
+    if ( !outBufferRelease( &out ) ) {
+        manageError( "writing headers" );
+    }
+
+    return toret;
+}
+
+/**
+ * writeHeadersByByte writes all headers, padding and fillers one byte at a time
+ * @return the number of bytes written
+ */
+unsigned long long writeHeadersByByte(FILE * f, unsigned long numChunks)
+{
+    static const char z = 0;
+    unsigned long long toret = 0;
+    unsigned long i;
+    int j;
+
+    for(i = 0; i < numChunks; i++) {
+        unsigned long length = getLength( i );
+
+        if ( i % FillerEvery == 0 ) {
+            writeId( f, FillerId );
+            writeInt( f, ChunkHeaderLen );
+
+            for(j = 0; j < ChunkHeaderLen; j++) {
+                fwrite( &z, 1, 1, f );
+            }
+
+            toret += 2 * ChunkHeaderLen;
+        }
+
+        writeId( f, ChunkIds[ i % ( sizeof( ChunkIds ) / sizeof( ChunkIds[ 0 ] ) ) ] );
+        writeInt( f, length );
+        toret += ChunkHeaderLen;
+
+        if ( length % 2 ) {
+            fwrite( &z, 1, 1, f );
+            ++toret;
+        }
+    }
+
+    if ( fflush( f ) != 0 ) {
+        manageError( "writing headers" );
+    }
+
+    return toret;
+}
+
+/**
+ * measure writes the headers of numChunks chunks to a temporary file,
+ * and prints the time taken
+ */
+void measure(const char * writer, unsigned long numChunks, int run,
+             unsigned long long (*writeHeaders)(FILE *, unsigned long))
+{
+    FILE * f = tmpfile();
+    unsigned long long bytesWritten;
+    double start;
+    double wall;
+
+    if ( f == NULL ) {
+        manageError( "can't create temporary file" );
+    }
+
+    start = getWallTime();
+    bytesWritten = writeHeaders( f, numChunks );
+    wall = getWallTime() - start;
+    fclose( f );
+
+    printf( "{\"writer\": \"%s\", \"chunks\": %lu, \"run\": %d, \"wall\": %.6f, "
+            "\"nsPerChunk\": %.1f, \"bytesWritten\": %llu}\n",
+            writer, numChunks, run, wall, wall * 1e9 / numChunks, bytesWritten );
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long numChunks = ( argc > 1 ) ? strtoul( argv[ 1 ], NULL, 10 ) : 50000;
+    int runs = ( argc > 2 ) ? atoi( argv[ 2 ] ) : 5;
+    int run;
+
+    if ( numChunks == 0 ) {
+        manageError( "invalid number of chunks" );
+    }
+
+    for(run = 1; run <= runs; run++) {
+        measure( "OutBuffer", numChunks, run, writeHeadersBuffered );
+        measure( "fwrite", numChunks, run, writeHeadersByByte );
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,49 @@
+#! /bin/sh
+
+#===============================================================================
+# Microbenchmark of the emission of chunk headers: compiles headers.c with
+# the OutBuffer of src/util.c, and writes a line of JSON for each run with
+# the time taken to write the headers, padding and filler chunks of a blorb
+# of many small chunks, with an OutBuffer and one byte at a time with fwrite(),
+# as bresc did before. Payloads are not written, so that opening and copying
+# resource files does not hide the cost of the headers; for the cost of whole
+# builds, see benchmark.sh.
+#
+# The compiler is $CC, or cc.
+#
+# Usage: headers.sh [-n 50000] [-r runs] [-o results.jsonl] [-w work-dir]
+#-------------------------------------------------------------------------------
+
+bench_location=`dirname "$0"`
+chunks=50000
+runs=5
+output=
+work_dir=
+
+while getopts "n:r:o:w:" op; do
+	case $op in
+		n) chunks=$OPTARG;;
+		r) runs=$OPTARG;;
+		o) output=$OPTARG;;
+		w) work_dir=$OPTARG;;
+		*) sed -n 's/^# Usage: /Usage: /p' "$0" >&2; exit 1;;
+	esac
+done
+
+if [ -z "$work_dir" ]; then
+	work_dir=`mktemp -d "${TMPDIR:-/tmp}/bresc-bench.XXXXXX"` || exit 1
+	trap 'rm -rf "$work_dir"' 0
+fi
+
+if ! ${CC:-cc} -O2 -I"$bench_location/../src" -o "$work_dir/headers" \
+		"$bench_location/headers.c" "$bench_location/../src/util.c"
+then
+	echo "can't compile headers.c" >&2
+	exit 1
+fi
+
+if [ -n "$output" ]; then
+	exec > "$output"
+fi
+
+"$work_dir/headers" "$chunks" "$runs"
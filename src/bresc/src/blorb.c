@@ -0,0 +1,322 @@
+/* blorb.c */
+
+/* Blorb files can be 4 GiB long: offsets of 64 bits, even on 32-bit systems */
+#ifndef _FILE_OFFSET_BITS
+#  define _FILE_OFFSET_BITS 64
+#endif
+
+/* POSIX functions (fseeko, fileno, fdopen...) are declared even with -std=c99 */
+#ifndef _XOPEN_SOURCE
+#  define _XOPEN_SOURCE 700
+#endif
+
+#include "blorb.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#  define fseeko _fseeki64
+#  define ftello _ftelli64
+#else
+#  include <unistd.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+/** Ownership of the contents of a blorb */
+#define OwnedByCaller 0
+#define OwnedMapped   1
+#define OwnedAlloc    2
+
+unsigned int readLong(const char *f)
+{
+    const unsigned char * v = (const unsigned char *) f;
+
+    return ( v[ 0 ] << 24 ) | ( v[ 1 ] << 16 ) | ( v[ 2 ] << 8 ) | v[ 3 ];
+}
+
+/**
+ * strId writes a blorb identifier to a string (4 bytes, space padded),
+ * for looking it up in the index
+ * @param f The string
+ * @param s The blorb identifier
+ */
+static void strId(char *f, const char *s)
+{
+    unsigned int i;
+    static const char sp = ' ';
+    unsigned int lenId = strlen( s );
+
+    if ( lenId > BlorbIdLen ) {
+        lenId = BlorbIdLen;
+    }
+
+    for ( i=0; i < lenId; i++) {
+        f[ i ] = s[ i ];
+    }
+    for (; i < BlorbIdLen; i++) {
+        f[ i ] = sp;
+    }
+}
+
+/**
+ * readId copies a blorb identifier to a string, without the padding spaces
+ * @param dest The string, of at least 5 chars
+ * @param org The blorb identifier
+ */
+static void readId(char *dest, const char *org)
+{
+    int i;
+
+    memcpy( dest, org, BlorbIdLen );
+    dest[ BlorbIdLen ] = 0;
+
+    for(i = BlorbIdLen - 1; i >= 0 && dest[ i ] == ' '; --i) {
+        dest[ i ] = 0;
+    }
+}
+
+/**
+ * cmpResources compares two entries of the index by usage and number,
+ * for qsort & bsearch
+ */
+static int cmpResources(const void * a, const void * b)
+{
+    const BlorbResource * r1 = (const BlorbResource *) a;
+    const BlorbResource * r2 = (const BlorbResource *) b;
+    int toret = strcmp( r1->Use, r2->Use );
+
+    if ( toret == 0 ) {
+        toret = ( r1->Res > r2->Res ) - ( r1->Res < r2->Res );
+    }
+
+    return toret;
+}
+
+/**
+ * readIndex validates the header of the blorb, and reads its index.
+ * Only the header and the index are touched.
+ */
+static BlorbResults readIndex(Blorb * blorb)
+{
+    const char * data = (const char *) blorb->data;
+    unsigned long indexLength;
+    unsigned int i;
+    const char * dp;
+
+    /* FORM <length> IFRS, and then RIdx <length> <number of entries> */
+    if ( blorb->length < BlorbHeaderLen + ChunkHeaderLen + 4
+      || memcmp( data, "FORM", BlorbIdLen )
+      || memcmp( data + 8, "IFRS", BlorbIdLen )
+      || readLong( data + 4 ) > blorb->length - 8 )
+    {
+        return BlorbBadHeader;
+    }
+
+    indexLength = readLong( data + BlorbHeaderLen + 4 );
+    dp = data + BlorbHeaderLen + ChunkHeaderLen;
+
+    if ( memcmp( data + BlorbHeaderLen, "RIdx", BlorbIdLen )
+      || indexLength < 4
+      || indexLength > blorb->length - BlorbHeaderLen - ChunkHeaderLen
+      || readLong( dp ) > ( indexLength - 4 ) / IndexEntryLen )
+    {
+        return BlorbBadIndex;
+    }
+
+    blorb->numResources = readLong( dp );
+    blorb->resources = (BlorbResource *) malloc( ( blorb->numResources + 1 ) * sizeof( BlorbResource ) );
+    blorb->sorted = (BlorbResource *) malloc( ( blorb->numResources + 1 ) * sizeof( BlorbResource ) );
+
+    if ( blorb->resources == NULL
+      || blorb->sorted == NULL )
+    {
+        return BlorbCantOpen;
+    }
+
+    for(i = 0, dp += 4; i < blorb->numResources; i++, dp += IndexEntryLen) {
+        readId( blorb->resources[ i ].Use, dp );
+        blorb->resources[ i ].Res = readLong( dp + 4 );
+        blorb->resources[ i ].Offset = readLong( dp + 8 );
+    }
+
+    memcpy( blorb->sorted, blorb->resources, blorb->numResources * sizeof( BlorbResource ) );
+    qsort( blorb->sorted, blorb->numResources, sizeof( BlorbResource ), cmpResources );
+
+    return BlorbOk;
+}
+
+BlorbResults blorbOpenMemory(Blorb * blorb, const void * data, size_t length)
+{
+    BlorbResults toret;
+
+    blorb->data = (const unsigned char *) data;
+    blorb->length = length;
+    blorb->resources = blorb->sorted = NULL;
+    blorb->numResources = 0;
+    blorb->ownership = OwnedByCaller;
+
+    toret = readIndex( blorb );
+
+    if ( toret != BlorbOk ) {
+        blorbClose( blorb );
+    }
+
+    return toret;
+}
+
+BlorbResults blorbOpenFile(Blorb * blorb, const char * fileName)
+{
+    BlorbResults toret;
+    const unsigned char * data = NULL;
+    size_t length = 0;
+    int ownership = OwnedAlloc;
+
+#ifndef _WIN32
+    struct stat info;
+    int fd = open( fileName, O_RDONLY );
+
+    if ( fd < 0 ) {
+        return BlorbCantOpen;
+    }
+
+    /* Files larger than the address space (on 32-bit hosts) are not mapped */
+    if ( fstat( fd, &info ) == 0
+      && info.st_size > 0
+      && (off_t) (size_t) info.st_size == info.st_size )
+    {
+        void * map = mmap( NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+
+        if ( map != MAP_FAILED ) {
+            data = (const unsigned char *) map;
+            length = info.st_size;
+            ownership = OwnedMapped;
+        }
+    }
+
+    close( fd );
+#endif
+
+    /* Read the file, if it could not be mapped */
+    if ( data == NULL ) {
+        FILE * in = fopen( fileName, "rb" );
+        unsigned char * buffer = NULL;
+        long long fileLength = -1;
+
+        if ( in == NULL ) {
+            return BlorbCantOpen;
+        }
+
+        if ( fseeko( in, 0, SEEK_END ) == 0 ) {
+            fileLength = ftello( in );
+        }
+
+        if ( fileLength > 0
+          && (long long) (size_t) fileLength == fileLength )
+        {
+            buffer = (unsigned char *) malloc( fileLength );
+        }
+
+        if ( buffer == NULL
+          || fseeko( in, 0, SEEK_SET ) != 0
+          || fread( buffer, 1, fileLength, in ) != (size_t) fileLength )
+        {
+            free( buffer );
+            fclose( in );
+            return ( fileLength == 0 ) ? BlorbBadHeader : BlorbCantOpen;
+        }
+
+        fclose( in );
+        data = buffer;
+        length = fileLength;
+    }
+
+    toret = blorbOpenMemory( blorb, data, length );
+
+    if ( toret == BlorbOk ) {
+        blorb->ownership = ownership;
+    } else {
+        blorb->data = data;
+        blorb->length = length;
+        blorb->ownership = ownership;
+        blorbClose( blorb );
+    }
+
+    return toret;
+}
+
+void blorbClose(Blorb * blorb)
+{
+    if ( blorb->data != NULL ) {
+#ifndef _WIN32
+        if ( blorb->ownership == OwnedMapped ) {
+            munmap( (void *) blorb->data, blorb->length );
+        }
+#endif
+
+        if ( blorb->ownership == OwnedAlloc ) {
+            free( (void *) blorb->data );
+        }
+    }
+
+    free( blorb->resources );
+    free( blorb->sorted );
+
+    blorb->data = NULL;
+    blorb->length = 0;
+    blorb->resources = blorb->sorted = NULL;
+    blorb->numResources = 0;
+    blorb->ownership = OwnedByCaller;
+}
+
+const BlorbResource * blorbFind(const Blorb * blorb, const char * use, unsigned int res)
+{
+    BlorbResource key;
+    char id[ BlorbIdLen ];
+
+    strId( id, use );
+    readId( key.Use, id );
+    key.Res = res;
+
+    return (const BlorbResource *) bsearch( &key, blorb->sorted, blorb->numResources,
+                                            sizeof( BlorbResource ), cmpResources );
+}
+
+bool blorbGetChunk(const Blorb * blorb, unsigned long offset, BlorbView * view)
+{
+    const char * data = (const char *) blorb->data;
+
+    /* Lengths are compared by subtracting, so nothing wraps around in 32 bits */
+    if ( offset > blorb->length
+      || blorb->length - offset < ChunkHeaderLen )
+    {
+        return false;
+    }
+
+    readId( view->Type, data + offset );
+    view->Length = readLong( data + offset + 4 );
+    view->Data = blorb->data + offset + ChunkHeaderLen;
+
+    if ( view->Length > blorb->length - offset - ChunkHeaderLen ) {
+        return false;
+    }
+
+    /* AIFF files are stored as they are, as FORM chunks */
+    if ( !strcmp( view->Type, "FORM" ) ) {
+        view->Data -= ChunkHeaderLen;
+        view->Length += ChunkHeaderLen;
+    }
+
+    return true;
+}
+
+bool blorbGetResource(const Blorb * blorb, const char * use, unsigned int res, BlorbView * view)
+{
+    const BlorbResource * resource = blorbFind( blorb, use, res );
+
+    return ( resource != NULL
+          && blorbGetChunk( blorb, resource->Offset, view ) );
+}
@@ -0,0 +1,124 @@
+/* blorb.h */
+
+/*
+    A small library for reading blorb files. The file is mapped in memory
+    (or given as a memory region), its index is parsed once, and resources
+    are looked up by usage and number with a binary search.
+    Views of chunks point inside the blorb: nothing is copied.
+    It does only depend on the standard library (and mmap, when available).
+*/
+
+#ifndef BLORB_H
+#define BLORB_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/** Size of Blorb ID Chunks */
+#define BlorbIdLen 4
+
+/** Size of the header of the blorb file: 'FORM', length, 'IFRS' */
+#define BlorbHeaderLen 12
+
+/** Size of the header of each chunk: id, length */
+#define ChunkHeaderLen 8
+
+/** Size of each entry in the resource index: use, res number, offset */
+#define IndexEntryLen 12
+
+/** Results of opening a blorb file */
+typedef enum _BlorbResults {
+    BlorbOk, BlorbCantOpen, BlorbBadHeader, BlorbBadIndex
+} BlorbResults;
+
+/** An entry of the index (RIdx) of a blorb file */
+typedef struct _BlorbResource {
+    char Use[5];
+    unsigned int Res;
+    unsigned long Offset;
+} BlorbResource;
+
+/** A chunk inside a blorb file. Data points inside the blorb.
+ * AIFF sounds are stored as FORM chunks, so their view includes the header,
+ * and they are a complete AIFF file.
+ */
+typedef struct _BlorbView {
+    char Type[5];
+    const unsigned char * Data;
+    unsigned long Length;
+} BlorbView;
+
+/** An open blorb file */
+typedef struct _Blorb {
+    const unsigned char * data;
+    size_t length;
+    /** Entries of the index, in the order of the file */
+    BlorbResource * resources;
+    /** Entries of the index, sorted by usage and number */
+    BlorbResource * sorted;
+    unsigned int numResources;
+    /** How data is owned: 0 - by the caller, 1 - mapped, 2 - allocated */
+    int ownership;
+} Blorb;
+
+/**
+    blorbOpenFile() - opens a blorb file, mapping it in memory when possible,
+                      and reads its index
+    @param blorb The blorb, to be released with blorbClose()
+    @param fileName The name of the file
+    @return BlorbOk, or the reason it could not be opened
+*/
+BlorbResults blorbOpenFile(Blorb * blorb, const char * fileName);
+
+/**
+    blorbOpenMemory() - opens a blorb already in memory, and reads its index.
+                        The memory is not copied, and must outlive the blorb.
+    @param blorb The blorb, to be released with blorbClose()
+    @param data The contents of the blorb file
+    @param length The length of the contents
+    @return BlorbOk, or the reason it could not be opened
+*/
+BlorbResults blorbOpenMemory(Blorb * blorb, const void * data, size_t length);
+
+/**
+    blorbClose() - releases a blorb opened with blorbOpenFile() or blorbOpenMemory()
+    @param blorb The blorb
+*/
+void blorbClose(Blorb * blorb);
+
+/**
+    blorbFind() - finds a resource in the index, in O(log n)
+    @param blorb The blorb
+    @param use The usage of the resource: "Pict", "Snd", "Exec"...
+    @param res The number of the resource
+    @return the entry of the index, or NULL if there is no such resource
+*/
+const BlorbResource * blorbFind(const Blorb * blorb, const char * use, unsigned int res);
+
+/**
+    blorbGetChunk() - gets a view of the chunk at a given offset
+    @param blorb The blorb
+    @param offset The position of the chunk in the file
+    @param view Where the view of the chunk is stored
+    @return true if the chunk is inside the file, false otherwise
+*/
+bool blorbGetChunk(const Blorb * blorb, unsigned long offset, BlorbView * view);
+
+/**
+    blorbGetResource() - finds a resource and gets a view of its chunk
+    @param blorb The blorb
+    @param use The usage of the resource: "Pict", "Snd", "Exec"...
+    @param res The number of the resource
+    @param view Where the view of the chunk is stored
+    @return true if the resource was found, false otherwise
+*/
+bool blorbGetResource(const Blorb * blorb, const char * use, unsigned int res, BlorbView * view);
+
+/**
+    readLong() - reads a long from a string, in the big-endian format of blorb files
+    @param f The string to read the number from (4 bytes)
+    @return The number
+*/
+unsigned int readLong(const char *f);
+
+#endif
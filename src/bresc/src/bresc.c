@@ -9,6 +9,7 @@
  */
 
 #include "util.h"
+#include "blorb.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -17,18 +18,54 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <time.h>
+#include <sys/stat.h>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#  define HAVE_THREADS
+#  include <pthread.h>
+#  include <unistd.h>
+#  include <sys/wait.h>
+#endif
+
+#ifdef __linux__
+#  define HAVE_INOTIFY
+#  include <sys/inotify.h>
+#  include <poll.h>
+#endif
 
 /** Max buffer size for all operations */
 #define BufferSize 8192
 
-/** Maximum number of chunks we'll allow in a blob file */
-#define MaxChunksBlorb 1024
-
 /** Short string size */
 #define ShortStringSize 512
 
-/** Size of Blorb ID Chunks */
-#define BlorbIdLen 4
+/** Default alignment of large chunks, when aligning is requested */
+#define DefaultAlignment 4096
+
+/** Largest length in an IFF file (lengths are 32 bits),
+ * and largest blorb file: the length of its FORM does not include its header */
+#define MaxIffLength 0xFFFFFFFFUL
+#define MaxBlorbLength ( MaxIffLength + 8ULL )
+
+/** ID of IFF filler chunks */
+#define FillerId "    "
+
+/** ID of the resolution chunk, and length of its header and entries */
+#define ResolutionId "Reso"
+#define ResoHeaderLen 24
+#define ResoEntryLen 28
+
+/** Milliseconds without changes before building again, in watch mode */
+#define WatchDelay 100
+
+/** ID of the resource descriptions chunk */
+#define DescriptionsId "RDes"
+
+/** Number of bytes read from each resource file in order to validate it */
+#define HeaderCheckLen 2048
+
+/** Position of the signature in MOD files */
+#define ModSignaturePos 1080
 
 /* Options */
 const char * OptNoBli    = "nobli";
@@ -37,6 +74,28 @@ const char * OptBliOnly  = "blionly";
 const char * OptVerbose  = "verbose";
 const char * OptShortExt = "shortext";
 const char * OptHelp     = "help";
+const char * OptJobs     = "jobs";
+const char * OptIncremental = "incremental";
+const char * OptUpdateExec  = "update-exec";
+const char * OptExecLast    = "execlast";
+const char * OptLayout      = "layout";
+const char * OptAlign       = "align";
+const char * OptNoDedup     = "nodedup";
+const char * OptWindow      = "window";
+const char * OptDescribe    = "describe";
+const char * OptDimensions  = "dimensions";
+const char * OptList        = "list";
+const char * OptExtract     = "extract";
+const char * OptStats       = "stats";
+const char * OptStatsFile   = "stats-file";
+const char * OptBatch       = "batch";
+const char * OptWatch       = "watch";
+const char * OptReproducible = "reproducible";
+const char * OptDeps        = "md";
+const char * OptDepFile     = "mf";
+const char * OptDevMap      = "dev-map";
+const char * StatsJson      = "json";
+const char * StatsText      = "text";
 
 /** Allowed symbols in ID's, apart from letters and digits */
 const char * allowedSymbolsInIds = "_-";
@@ -52,95 +111,206 @@ const char * BlorbExt      = "blb";
 const char * BlorbZCodeExt = "zblorb";
 const char * BlorbGlulxExt = "gblorb";
 
+/** The output file name meaning the standard output */
+const char * StdOutName = "-";
+
 /** The default input file's extension */
 const char * DefaultInExt = "res";
 
 /** The default extension for bli files */
 const char * DefaultBliExt = "bli";
 
-typedef enum _PictureTypes {
-    PNG, JPG, PictureTypeError
-} PictureTypes;
+/** The default extension for dependency files */
+const char * DepFileExt = "d";
 
-const char * PictureChunkTypes[] = {
-    "PNG",
-    "JPEG",
-    ""
-};
+/** The default extension for resource maps, and their signature */
+const char * DevMapExt       = "map";
+const char * DevMapSignature = "bresc-resource-map";
+const int    DevMapVersion   = 1;
 
-typedef enum _SoundTypes {
-    OGG, AIFF, MOD, SoundTypeError
-} SoundTypes;
+/** The suffix for the manifest of incremental builds, and its signature */
+const char * ManifestSuffix    = ".manifest";
+const char * ManifestSignature = "bresc-manifest";
+const int    ManifestVersion   = 2;
 
-const char * SoundChunkTypes[] = {
-    "OGGV",     /* see http://www.vorbis.com/ for specification */
-    "AIFF",
-    "MOD",      /* ProTracker 2.0 format: 31 note samples, up to 128 note patterns */
-    ""
-};
+/** The suffix for temporary files */
+const char * TempSuffix = ".tmp";
 
-typedef enum _ExecutableTypes {
-    ZCOD, GLUL, TAD2, TAD3, HUGO, ALAN, ADRI, LEVE,
-    AGT, MAGS, ADVS,
-    ExecutableTypeError
-} ExecutableTypes;
-
-const char * ExecutableChunkTypes[] = {
-    "ZCOD",     /* Z virtual machine */
-    "GLUL",     /* Glulx virtual machine */
-    "TAD2",     /* TADS 2 virtual machine */
-    "TAD3",     /* TADS 3 virtual machine */
-    "HUGO",     /* HUGO virtual machine */
-    "ALAN",     /* Alan virtual machine */
-    "ADRI",     /* Adrift virtual machine */
-    "LEVE",     /* Level 9 virtual machine */
-    "AGT",      /* AGT virtual machine */
-    "MAGS",     /* Magnetic Scrolls virtual machine */
-    "ADVS",     /* AdvSys virtual machine */
-    "EXEC",     /* Native executable */
-    ""
-};
+/** The lines of the bli header with the date, which are not compared */
+const char * BliGeneratedPrefix = "! Generated by ";
+const char * BliMessagePrefix   = "message \"Including resources file by ";
+
+/** The environment variable with the date for reproducible builds */
+const char * SourceDateEpochVar = "SOURCE_DATE_EPOCH";
 
 const char * ChunkUsages[] = {
     "Exec",
     "Pict",
     "Snd",
+    "Data",
     "IFmd",
     "Fspc",
     "ERR",
     ""
 };
 
-const char * ChunkUsagesAlternateIds[] = {
-    " EXEC EXE CODE  ",
-    " PICT PIC PICTURE ",
-    " SND MSC MUSIC SOUND ",
-    " META MTA BIBLIO BIBLIOGRAPHIC BIB IFMD ",
-    " POSTER POST COV COVER FRONT FSPC ",
-    ""
-};
-
 const char * VblePrefixes[] = {
     "exe",
     "pic",
     "snd",
+    "dat",
     ""
 };
 
 typedef enum _Usages {
-        Exec, Pict, Snd, IFmd, Fspc, UsageError
+        Exec, Pict, Snd, Data, IFmd, Fspc, UsageError
 } Usages;
 
+/** A keyword for a use in the res file, and the use it stands for */
+typedef struct _UsageAlias {
+    const char * Alias;
+    Usages Use;
+} UsageAlias;
+
+const UsageAlias UsageAliases[] = {
+    { "EXEC", Exec }, { "EXE", Exec }, { "CODE", Exec },
+    { "PICT", Pict }, { "PIC", Pict }, { "PICTURE", Pict },
+    { "SND", Snd }, { "MSC", Snd }, { "MUSIC", Snd }, { "SOUND", Snd },
+    { "DATA", Data }, { "DAT", Data },
+    { "META", IFmd }, { "MTA", IFmd }, { "BIBLIO", IFmd },
+    { "BIBLIOGRAPHIC", IFmd }, { "BIB", IFmd }, { "IFMD", IFmd },
+    { "POSTER", Fspc }, { "POST", Fspc }, { "COV", Fspc },
+    { "COVER", Fspc }, { "FRONT", Fspc }, { "FSPC", Fspc },
+    { NULL, UsageError }
+};
+
+/** Phases of the compilation, timed for the statistics */
+typedef enum _Phases {
+    PhaseParse, PhaseBli, PhaseLoad, PhaseIndex, PhaseWrite, NumPhases
+} Phases;
+
+const char * PhaseNames[] = {
+    "parse",
+    "bli",
+    "load",
+    "index",
+    "write",
+    ""
+};
+
+/** Orders of the chunks in the blorb */
+typedef enum _Layouts {
+    LayoutRes, LayoutStartup, LayoutExecLast, LayoutError
+} Layouts;
+
+const char * LayoutNames[] = {
+    "res",
+    "startup",
+    "execlast",
+    ""
+};
+
+/** Formats of the statistics */
+typedef enum _StatsFormats {
+    StatsNone, StatsPlain, StatsJsonFormat
+} StatsFormats;
+
+/** Classes of characters in the res file, as bit flags */
+typedef enum _CharClasses {
+    ClassField = 1, ClassLine = 2, ClassComment = 4, ClassIdStart = 8, ClassId = 16
+} CharClasses;
+
+/** An entry in the res file: use, optional id, and file name.
+ * All strings point inside the contents of the res file.
+ */
+typedef struct _ResEntry {
+    char *Use;
+    char *Id;
+    char *Path;
+    unsigned int Line;
+    bool Preload;
+} ResEntry;
+
+/** A project built in batch mode, by its own process */
+typedef struct _BatchJob {
+    char *InName;
+    /** The output file, or NULL for the name of the res file */
+    char *OutName;
+    /** The process building the project (0 if not started) */
+    long Pid;
+    /** The exit code of the process, or -1 if it was killed by a signal */
+    int ExitCode;
+    int Signal;
+    /** Wall-clock time of the build, in seconds */
+    double Wall;
+} BatchJob;
+
+/** A file of the project, watched for changes in watch mode */
+typedef struct _WatchedFile {
+    /** The directory of the file, with the trailing separator, or "" */
+    char *Dir;
+    char *Name;
+    /** The watch of the directory */
+    int Wd;
+} WatchedFile;
+
+/** The files watched in watch mode, which live in their own arena.
+ * The inotify instance lives as long as the list, so no change is lost between builds */
+typedef struct _WatchList {
+    Arena arena;
+    WatchedFile * files;
+    int numFiles;
+    int maxFiles;
+    int fd;
+} WatchList;
+
+/** Result of loading (sizing and validating) a resource file */
+typedef enum _LoadResults {
+    LoadOk, LoadCantOpen, LoadBadHeader, LoadTooLarge
+} LoadResults;
+
 /** The blorb chunk type.
- * In addition to the chunk data, it holds the index information if needed
+ * In addition to the chunk data, it holds the index information if needed.
+ * Chunks coming from resource files do not keep their contents in memory:
+ * only FileName is stored, and the data is copied when the blorb is written.
+ * Data is used only for chunks generated by bresc itself (index, cover).
+ * Original is the position of a previous chunk with the same contents,
+ * which is shared with this one (0 if none).
+ * Preload chunks are needed when the story starts. Padding is the size of
+ * the filler chunk written before this one, in order to align it.
+ * Width and Height are the dimensions of pictures, read from their headers.
  */
 typedef struct _Chunk {
     char Type[ BlorbIdLen + 1 ];
     char Use[ BlorbIdLen + 1 ];
     unsigned int Res;
     unsigned long Length;
+    unsigned long Offset;
     char *Data;
+    char *FileName;
+    unsigned int Line;
+    LoadResults Load;
+    long long MTime;
+    unsigned long long Hash;
+    bool Reused;
+    unsigned long OldOffset;
+    unsigned int Original;
+    bool Preload;
+    unsigned long Padding;
+    unsigned int Width;
+    unsigned int Height;
 } Chunk;
+
+/** An entry in the manifest of a previous build, for incremental builds.
+ * Hash is zero when the contents of the file could not be hashed.
+ */
+typedef struct _ManifestEntry {
+    char *Path;
+    unsigned long Offset;
+    unsigned long Length;
+    long long MTime;
+    unsigned long long Hash;
+} ManifestEntry;
 
 typedef struct _status {
     /* Chunk count / use */
@@ -148,6 +318,8 @@ typedef struct _status {
     unsigned int nextChunkForPicts;
     /** Ids for chunk types = Snd */
     unsigned int nextChunkForSnds;
+    /** Ids for chunk types = Data */
+    unsigned int nextChunkForData;
     /** Ids for chunk types = Exec */
     unsigned int nextChunkForExecs;
     /** Ids for chunk types = IFmd, Fspc... */
@@ -162,7 +334,7 @@ typedef struct _status {
     /** Cover ? */
     bool thereIsCover;
     /** Cover chunk number */
-    unsigned coverChunk;
+    int coverChunk;
     /** Cover res number */
     unsigned int coverId;
     /** Using short extension (blb) */
@@ -171,26 +343,115 @@ typedef struct _status {
     bool thereIsBib;
     /** The current line in the res control file */
     unsigned int lineNumber;
-    /** Array of all chunks */
-    Chunk *BlorbChunks[ MaxChunksBlorb ];
+    /** Array of all chunks, growing as needed */
+    Chunk *BlorbChunks;
     /** Number of chunks in this file */
     int numberOfChunks;
+    /** Number of chunks that fit in BlorbChunks */
+    int maxChunks;
     /** Number of chunks we need to index */
     int numberOfIndexEntries;
-    /** Offsets of index entries */
-    unsigned long int *indexOffsets;
+    /** Total length of the blorb file */
+    unsigned long long blorbLength;
     /** Program name */
     char * myName;
     /** File path */
     char * path;
-    /** Report contents */
-    char *report;
     /** Default extension */
     const char * outFileExt;
     /** Is a Glulx story file or not */
     bool isGlulx;
+    /** Number of threads used for loading resource files */
+    unsigned int jobs;
+    /* Incremental builds */
+    /** Reuse unchanged chunks from the previous blorb */
+    bool incremental;
+    /** Entries of the manifest of the previous build, sorted by path */
+    ManifestEntry * manifest;
+    /** Number of entries in the manifest */
+    int manifestSize;
+    /** When the manifest was written: files modified since then are hashed */
+    long long manifestTime;
+    /** The previous blorb file, from which chunks are reused */
+    FILE * oldBlorb;
+    /** Name of the blorb file while it is being written */
+    char * tempName;
+    /* Memory */
+    /** Arena for all strings and generated chunk data, released at the end */
+    Arena arena;
+    /** The class of each character, for the res file tokenizer */
+    unsigned char charClasses[ 256 ];
+    /** Entries of the res file */
+    ResEntry * entries;
+    /** Number of entries in the res file */
+    int numberOfEntries;
+    /* Updating the executable chunk */
+    /** The story file to put in an existing blorb, if any */
+    char * updateExec;
+    /* Layout */
+    /** Order of the chunks in the blorb */
+    Layouts layout;
+    /** Chunks at least this long are aligned to it (0 means no alignment) */
+    unsigned long alignment;
+    /* Metadata of pictures */
+    /** Size of the standard window for the Reso chunk (0 means no Reso chunk) */
+    unsigned int windowWidth;
+    unsigned int windowHeight;
+    /** Generate the RDes chunk */
+    bool describe;
+    /** Write the dimensions of pictures in the bli file */
+    bool dimensions;
+    /* Deduplication */
+    /** Share one chunk among resources with the same contents */
+    bool dedup;
+    /** Number of resources sharing the chunk of another one */
+    int numberOfDuplicates;
+    /** Bytes not written thanks to sharing chunks */
+    unsigned long long bytesDeduplicated;
+    /* Inspecting blorb files */
+    /** List the resources of the blorb given as in-file */
+    bool listBlorb;
+    /** Usage and number of the resource to extract, if any */
+    char * extractUse;
+    char * extractRes;
+    /* Batch builds */
+    /** File listing the projects to build, if any */
+    char * batchName;
+    /* Watch mode */
+    /** Rebuild the project each time its files change */
+    bool watch;
+    /** Pipe to the watcher, for the files of the project (-1 if none) */
+    int watchFd;
+    /* Reproducible builds */
+    /** Leave the date out of the bli file, unless SOURCE_DATE_EPOCH gives it */
+    bool reproducible;
+    /** Name of the bli file while it is being written */
+    char * bliTempName;
+    /* Dependencies */
+    /** Write a dependency file for make */
+    bool deps;
+    /** Name of the dependency file (NULL for the name of the output file) */
+    char * depName;
+    /* Development builds */
+    /** Write a resource map pointing to the resource files, instead of a blorb */
+    bool devMap;
+    /* Statistics */
+    /** Format of the statistics, if they were requested */
+    StatsFormats statsFormat;
+    /** File the statistics are written to (stderr when NULL) */
+    char * statsName;
+    /** Wall-clock time spent in each phase, in seconds */
+    double phaseWall[ NumPhases ];
+    /** Processor time spent in each phase, in seconds */
+    double phaseCpu[ NumPhases ];
+    /** Bytes read from the res file and the resources */
+    unsigned long long bytesRead;
+    /** Bytes written to the blorb and bli files */
+    unsigned long long bytesWritten;
+    /** Stream for messages (stderr when the blorb goes to stdout) */
+    FILE * log;
     /** String for message errors */
-    char msg[ShortStringSize];
+    char msg[BufferSize];
     char * inName;
     char * outName;
     char * bliName;
@@ -203,16 +464,13 @@ typedef struct _status {
 const char * BrescApp          = "bresc";
 const char * BresApp           = "bres";
 const char * BlcApp            = "blc";
-const char * PngFilesExt       = "png";
-const char * JpgFilesExt       = "jpg";
-const char * OggFilesExt       = "ogg";
-const char * AifFilesExt       = "aif";
-const char * ModFilesExt       = "mod";
-const char * Z5FilesExt        = "z5";
-const char * Z8FilesExt        = "z8";
-const char * GlulxFilesExt     = "ulx";
-const char * IfictionFilesExt  = "ifiction";
+const char * BinFilesExt       = "bin";
 const char * CommentCharacters = ";.!#%&/:\\$->";
+const char * PreloadMarker     = "preload";
+const char * WidthSuffix       = "_width";
+const char * HeightSuffix      = "_height";
+const char * BatchStatsExt     = "stats";
+const char   BatchComment      = '#';
 
 
 /** The program information message string is formatted
@@ -225,10 +483,50 @@ const char * InfoMsg = "%s %s\n"
                        "Blorb resource compiler (%s is based on blc .5b by L. Ross Raszewski)\n"
 ;
 
+/**
+ * initCharClasses prepares the table of character classes,
+ * so the res file tokenizer needs only one lookup per character
+ * @see CharClasses
+ */
+void initCharClasses(Status * status)
+{
+    const char * ptr;
+    int c;
+
+    memset( status->charClasses, 0, sizeof( status->charClasses ) );
+
+    for(ptr = FieldDelimiters; *ptr != 0; ++ptr) {
+        status->charClasses[ (unsigned char) *ptr ] |= ClassField;
+    }
+
+    for(ptr = LineDelimiters; *ptr != 0; ++ptr) {
+        status->charClasses[ (unsigned char) *ptr ] |= ClassLine;
+    }
+
+    for(ptr = CommentCharacters; *ptr != 0; ++ptr) {
+        status->charClasses[ (unsigned char) *ptr ] |= ClassComment;
+    }
+
+    for(ptr = allowedSymbolsInIds; *ptr != 0; ++ptr) {
+        status->charClasses[ (unsigned char) *ptr ] |= ClassIdStart | ClassId;
+    }
+
+    for(c = 0; c < 256; ++c) {
+        if ( isalpha( c ) ) {
+            status->charClasses[ c ] |= ClassIdStart | ClassId;
+        }
+        else
+        if ( isdigit( c ) ) {
+            status->charClasses[ c ] |= ClassId;
+        }
+    }
+}
+
 void initStatus(char * argv[], Status *stats)
 {
     stats->nextChunkForPicts = 3;
     stats->nextChunkForSnds = 3;
+    stats->nextChunkForData = 1;
     stats->nextChunkForExecs = 0;
     stats->nextChunkForMeta = 0;
     stats->verbose = false;
@@ -239,76 +537,114 @@ void initStatus(char * argv[], Status *stats)
     stats->coverChunk = 0;
     stats->coverId = 0;
     stats->lineNumber = 0;
+    stats->BlorbChunks = NULL;
     stats->numberOfChunks = 0;
+    stats->maxChunks = 0;
     stats->numberOfIndexEntries = 0;
+    stats->blorbLength = 0;
     stats->path = NULL;
-    stats->indexOffsets = NULL;
     stats->inName = stats->outName = stats->bliName = NULL;
     stats->bli = stats->in = stats->out = NULL;
-    stats->report = NULL;
     stats->outFileExt = BlorbExt;
+    stats->log = stdout;
+    stats->jobs = 1;
+    stats->incremental = false;
+    stats->manifest = NULL;
+    stats->manifestSize = 0;
+    stats->manifestTime = 0;
+    stats->oldBlorb = NULL;
+    stats->tempName = NULL;
+    arenaInit( &stats->arena );
+    stats->entries = NULL;
+    stats->numberOfEntries = 0;
+    initCharClasses( stats );
+    stats->updateExec = NULL;
+    stats->layout = LayoutRes;
+    stats->alignment = 0;
+    stats->windowWidth = stats->windowHeight = 0;
+    stats->describe = false;
+    stats->dimensions = false;
+    stats->dedup = true;
+    stats->numberOfDuplicates = 0;
+    stats->bytesDeduplicated = 0;
+    stats->listBlorb = false;
+    stats->extractUse = stats->extractRes = NULL;
+    stats->batchName = NULL;
+    stats->watch = false;
+    stats->watchFd = -1;
+    stats->reproducible = false;
+    stats->bliTempName = NULL;
+    stats->deps = false;
+    stats->depName = NULL;
+    stats->devMap = false;
+    stats->statsFormat = StatsNone;
+    stats->statsName = NULL;
+    stats->bytesRead = stats->bytesWritten = 0;
+    memset( stats->phaseWall, 0, sizeof( stats->phaseWall ) );
+    memset( stats->phaseCpu, 0, sizeof( stats->phaseCpu ) );
 
-    stats->myName = getShortFileName( argv[ 0 ] );
+#ifdef HAVE_THREADS
+    {
+        long numCores = sysconf( _SC_NPROCESSORS_ONLN );
+
+        if ( numCores > 1 ) {
+            stats->jobs = numCores;
+        }
+    }
+#endif
+
+    stats->myName = getShortFileName( &stats->arena, argv[ 0 ] );
     strtolower( stats->myName );
 }
 
 /**
- * getVectorPos() - Returns the position of a string inside a vector of strings
- * The vector must be finished with a null string
- * @param s the string containing the possible use
- * @param v the vector of strings containing the possible use
- * @return the corresponding vector position, if found.
- * The position of null string otherwise
+ * startPhase starts timing a phase of the compilation
+ * @see endPhase
  */
-
-int getVectorPos(const char *v[], const char *s)
+void startPhase(Status * status, Phases phase)
 {
-    unsigned int i = 0;
-
-    for(; *v[ i ] != 0; ++i) {
-        if ( !strcmp( v[ i ], s ) ) {
-            break;
-        }
-    }
-
-    return i;
+    status->phaseWall[ phase ] -= getWallTime();
+    status->phaseCpu[ phase ] -= getCpuTime();
+}
 
+/**
+ * endPhase stops timing a phase of the compilation,
+ * accumulating the time spent in it
+ * @see startPhase
+ */
+void endPhase(Status * status, Phases phase)
+{
+    status->phaseWall[ phase ] += getWallTime();
+    status->phaseCpu[ phase ] += getCpuTime();
 }
 
 /**
  * Converts a string to its usage enumrated value
- * @see ChunkUsages
+ * @see UsageAliases
  * @param s the string containing the possible use
  * @return the corresponding usage value, if found. UsageError otherwise
  */
 Usages cnvtToUsages(const char *s)
 {
-    Usages toret = UsageError;
+    const UsageAlias * alias = UsageAliases;
+    char first;
 
-    if ( s != NULL
-      && *s != 0 )
-    {
-        /* Convert the string to spcSTRINGspc, so it can be found */
-        const unsigned int idLen = strlen( s );
-        const unsigned int neededLen = idLen + 3;
-        char * aux = my_malloc( neededLen );
-
-        memset( aux, 0, neededLen );
-        *aux = ' ';
-        memcpy( aux + 1, s, idLen );
-        *( aux + neededLen -2 ) = ' ';
-        strtoupper( aux );
-
-        for(toret = (Usages) 0; toret < UsageError; ++toret) {
-            if ( strstr( ChunkUsagesAlternateIds[ toret ], aux ) != NULL ) {
-                break;
-            }
-        }
+    if ( s == NULL ) {
+        return UsageError;
+    }
+
+    /* Aliases are in uppercase: most of them are discarded by their first letter */
+    first = toupper( (unsigned char) *s );
 
-        free( aux );
+    for(; alias->Alias != NULL; ++alias) {
+        if ( *( alias->Alias ) == first
+          && strEqualNoCase( alias->Alias, s ) )
+        {
+            break;
+        }
     }
 
-    return toret;
+    return alias->Use;
 }
 
 /**
@@ -330,47 +666,297 @@ bool chkUse(const char *s, Status * stat)
 }
 
 /**
- * Checks that the type is valid
- * @see ChunkTypes
- * @param s the string containing the possible type
- * @param use The use for this type
- * @return true if is found. False otherwise
+ * readJpegSize reads the dimensions of a JPEG picture from its SOF segment.
+ * Only the headers of the segments before it are read: the rest is skipped.
+ * @param in The JPEG file
+ * @param chunk The chunk, where the dimensions are stored
+ * @return true if a frame header was found before the image data
  */
-bool chkType(Usages use, const char *s, Status * stat)
+bool readJpegSize(FILE * in, Chunk * chunk)
 {
-    unsigned toret;
-    const char ** v = NULL;
-    *( stat->msg ) = 0;
+    unsigned char segment[ 7 ];
+    int marker;
 
-    if ( use == Exec ) {
-        v = ExecutableChunkTypes;
+    if ( fseek( in, 2, SEEK_SET ) != 0 ) {
+        return false;
     }
-    else
-    if ( use == Pict ) {
-        v = PictureChunkTypes;
+
+    for(;;) {
+        /* Markers are 0xFF, maybe repeated, and then the marker code */
+        if ( fgetc( in ) != 0xFF ) {
+            return false;
+        }
+
+        do {
+            marker = fgetc( in );
+        } while( marker == 0xFF );
+
+        if ( marker == EOF
+          || marker == 0xD9
+          || marker == 0xDA )
+        {
+            return false;
+        }
+
+        /* Standalone markers */
+        if ( marker == 0x01
+          || ( marker >= 0xD0 && marker <= 0xD8 ) )
+        {
+            continue;
+        }
+
+        if ( fread( segment, 1, 2, in ) != 2
+          || ( ( segment[ 0 ] << 8 ) | segment[ 1 ] ) < 2 )
+        {
+            return false;
+        }
+
+        /* SOF0..SOF15, but DHT (C4), JPG (C8) and DAC (CC) */
+        if ( marker >= 0xC0 && marker <= 0xCF
+          && marker != 0xC4 && marker != 0xC8 && marker != 0xCC )
+        {
+            if ( fread( segment + 2, 1, 5, in ) != 5 ) {
+                return false;
+            }
+
+            chunk->Height = ( segment[ 3 ] << 8 ) | segment[ 4 ];
+            chunk->Width = ( segment[ 5 ] << 8 ) | segment[ 6 ];
+            return true;
+        }
+
+        if ( fseek( in, ( ( segment[ 0 ] << 8 ) | segment[ 1 ] ) - 2, SEEK_CUR ) != 0 ) {
+            return false;
+        }
     }
-    else
-    if ( use == Snd ) {
-        v = SoundChunkTypes;
+}
+
+/**
+ * isModSignature decides whether the signature of a MOD file is known:
+ * "M.K.", "M!K!", "FLTn", "nCHN" or "nnCH"
+ */
+bool isModSignature(const unsigned char * signature)
+{
+    return ( !memcmp( signature, "M.K.", 4 )
+          || !memcmp( signature, "M!K!", 4 )
+          || !memcmp( signature, "FLT", 3 )
+          || ( isdigit( signature[ 0 ] ) && !memcmp( signature + 1, "CHN", 3 ) )
+          || ( isdigit( signature[ 0 ] ) && isdigit( signature[ 1 ] )
+            && !memcmp( signature + 2, "CH", 2 ) ) );
+}
+
+/**
+ * Validators of the headers of resource files, for the registry of types.
+ * Each one checks the first bytes of a file against its type.
+ * The dimensions of pictures are read from their headers, without decoding them.
+ * Sounds are checked for the codec (Ogg Vorbis), the length of the
+ * FORM (AIFF) or the signature (MOD). Data in IFF must be a single FORM.
+ * @param chunk The chunk, with its type and length already known
+ * @param header The first bytes of the file
+ * @param len The number of bytes in header
+ * @param in The file, for reading headers beyond the first bytes
+ * @return true if the header matches the type
+ * @see ResourceTypes
+ */
+typedef bool (*HeaderValidator)(Chunk * chunk, const unsigned char * header, size_t len, FILE * in);
+
+bool chkPngHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    /* Signature, and then the IHDR chunk: length, 'IHDR', width, height */
+    bool toret = ( len >= 24
+                && !memcmp( header, "\x89PNG\r\n\x1a\n", 8 )
+                && !memcmp( header + 12, "IHDR", 4 ) );
+
+    (void) in;
+
+    if ( toret ) {
+        chunk->Width = readLong( (const char *) header + 16 );
+        chunk->Height = readLong( (const char *) header + 20 );
     }
 
-    if ( v != NULL ) {
-        toret = getVectorPos( v, s );
+    return toret;
+}
 
-        if ( *v[ toret ] == 0 ) {
-            sprintf( stat->msg, "%d: Illegal type '%s' for use '%s'",
-                stat->lineNumber,
-                ChunkUsages[ use ],
-                s
-            );
+bool chkJpegHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    return ( len >= 2 && header[ 0 ] == 0xFF && header[ 1 ] == 0xD8
+          && readJpegSize( in, chunk ) );
+}
+
+bool chkOggHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    (void) chunk;
+    (void) in;
+
+    /* The first page holds the Vorbis identification header,
+       after the 27 bytes of the page header and its segment table */
+    return ( len >= 27
+          && !memcmp( header, "OggS", 4 )
+          && len >= 27 + header[ 26 ] + 7U
+          && !memcmp( header + 27 + header[ 26 ], "\x01vorbis", 7 ) );
+}
+
+bool chkAiffHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    (void) in;
+
+    return ( len >= 12
+          && !memcmp( header, "FORM", 4 )
+          && ( !memcmp( header + 8, "AIFF", 4 )
+            || !memcmp( header + 8, "AIFC", 4 ) )
+          && readLong( (const char *) header + 4 ) <= chunk->Length - 8 );
+}
+
+bool chkModHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    (void) chunk;
+    (void) in;
+
+    return ( len >= ModSignaturePos + 4
+          && isModSignature( header + ModSignaturePos ) );
+}
+
+bool chkFormHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    (void) in;
+
+    /* Written as it is, so it must be exactly one FORM */
+    return ( len >= 12
+          && !memcmp( header, "FORM", 4 )
+          && readLong( (const char *) header + 4 ) == chunk->Length - 8 );
+}
+
+bool chkGlulxHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    (void) chunk;
+    (void) in;
+
+    return ( len >= 4 && !memcmp( header, "Glul", 4 ) );
+}
+
+bool chkZCodeHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    (void) chunk;
+    (void) in;
+
+    return ( len >= 1 && header[ 0 ] >= 1 && header[ 0 ] <= 8 );
+}
+
+/** A type of resource: the files of an extension, for a use, and their chunks */
+typedef struct _ResourceType {
+    /** The extension of the files, in lowercase, or "" for any other file of its use */
+    const char * Ext;
+    /** The use of the chunks */
+    Usages Use;
+    /** The type of the chunks */
+    const char * Type;
+    /** The validator of the header, or NULL if it is not checked */
+    HeaderValidator Validator;
+} ResourceType;
+
+/**
+ * The registry of resource types: a new type of resource only needs an entry here.
+ * The first entry of a type gives the usual extension of its files, for extracting them.
+ * The prefix of the constants in the bli file depends on the use.
+ * @see VblePrefixes
+ */
+const ResourceType ResourceTypes[] = {
+    { "png",      Pict, "PNG",  chkPngHeader },
+    { "jpg",      Pict, "JPEG", chkJpegHeader },
+    { "ogg",      Snd,  "OGGV", chkOggHeader },     /* see http://www.vorbis.com/ for specification */
+    { "aif",      Snd,  "AIFF", chkAiffHeader },
+    { "mod",      Snd,  "MOD",  chkModHeader },     /* ProTracker 2.0 format: 31 note samples, up to 128 note patterns */
+    { "z5",       Exec, "ZCOD", chkZCodeHeader },   /* Z virtual machine */
+    { "z8",       Exec, "ZCOD", chkZCodeHeader },
+    { "ulx",      Exec, "GLUL", chkGlulxHeader },   /* Glulx virtual machine */
+    { "ifiction", IFmd, "IFmd", NULL },
+    { "txt",      Data, "TEXT", NULL },             /* Text, read by the game with glk_stream_open_resource() */
+    { "iff",      Data, "FORM", chkFormHeader },    /* IFF file, written as it is */
+    { "bin",      Data, "BINA", NULL },             /* Binary data */
+    { "",         Data, "BINA", NULL },
+    { "aif",      Snd,  "FORM", NULL },             /* AIFF in blorb files by other tools, only extracted */
+    { NULL,       UsageError, "", NULL }
+};
+
+/**
+ * findResourceType finds the type of a resource file, from its extension.
+ * If the use has no type for it, its default type (extension "") is used.
+ * Failing that, an extension of another use is accepted, so chkType() can report it.
+ * @param use The use of the resource
+ * @param ext The extension of the file, in lowercase
+ * @return The type, or NULL if the extension is unknown
+ * @see ResourceTypes
+ */
+const ResourceType * findResourceType(Usages use, const char * ext)
+{
+    const ResourceType * other = NULL;
+    const ResourceType * byDefault = NULL;
+    const ResourceType * type = ResourceTypes;
+
+    for(; type->Ext != NULL; ++type) {
+        if ( !strcmp( type->Ext, ext ) ) {
+            if ( type->Use == use ) {
+                return type;
+            }
+
+            if ( other == NULL ) {
+                other = type;
+            }
         }
-    } else {
-        v = ChunkUsages;
-        toret = use;
-        sprintf( stat->msg, "%d: Illegal use '%s' with type '%s'", stat->lineNumber, v[ use ], s );
+        else
+        if ( *( type->Ext ) == 0
+          && type->Use == use )
+        {
+            byDefault = type;
+        }
+    }
+
+    return ( byDefault != NULL ) ? byDefault : other;
+}
+
+/**
+ * findResourceTypeById finds the first entry of a type of chunk in the registry
+ * @param use The use of the chunk, or UsageError for any
+ * @param id The type of the chunk (without padding spaces)
+ * @return The type, or NULL if it is unknown
+ * @see ResourceTypes
+ */
+const ResourceType * findResourceTypeById(Usages use, const char * id)
+{
+    const ResourceType * type = ResourceTypes;
+
+    for(; type->Ext != NULL; ++type) {
+        if ( !strcmp( type->Type, id )
+          && ( use == UsageError
+            || type->Use == use ) )
+        {
+            return type;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Checks that the type is valid
+ * @see ResourceTypes
+ * @param s the string containing the possible type
+ * @param use The use for this type
+ * @return true if is found. False otherwise
+ */
+bool chkType(Usages use, const char *s, Status * stat)
+{
+    bool toret = ( findResourceTypeById( use, s ) != NULL );
+    *( stat->msg ) = 0;
+
+    if ( !toret ) {
+        sprintf( stat->msg, "%d: Illegal type '%s' for use '%s'",
+            stat->lineNumber,
+            s,
+            ChunkUsages[ use ]
+        );
     }
 
-    return ( *v[ toret ] != 0 );
+    return toret;
 }
 
 /**
@@ -404,99 +990,47 @@ inline
 bool isSndUse(const char *s)
 {
     return ( cnvtToUsages( s ) == Snd );
-}
-
-/** writeInt writes an integer to a file in blorb format
- * @param f file handle
- * @param v number to write
- */
-inline
-void writeInt(FILE *f, unsigned int v)
-{
-    unsigned char v1 = v&0xFF;
-    unsigned char v2 = (v>>8)&0xFF;
-    unsigned char v3 = (v>>16)&0xFF;
-    unsigned char v4 = (v>>24)&0xFF;
-
-    fwrite( &v4, 1, 1, f );
-    fwrite( &v3, 1, 1, f );
-    fwrite( &v2, 1 ,1, f );
-    fwrite( &v1, 1 ,1 ,f );
-}
-
-/** strLong writes a long to a string, in a format suitable to later
- * using with write_id
- * @param f The string to write the number to
- * @param v The number to write
- */
-inline
-void strLong(char *f, unsigned int v)
-{
-    unsigned char v1 = v&0xFF;
-    unsigned char v2 = (v>>8)&0xFF;
-    unsigned char v3 = (v>>16)&0xFF;
-    unsigned char v4 = (v>>24)&0xFF;
-
-    f[ 0 ] = v4;
-    f[ 1 ] = v3;
-    f[ 2 ] = v2;
-    f[ 3 ] = v1;
 }
 
-/** strShort writes a short to a string, in a format suitable to later
- * using with write_id
- * @param f The string to write the number to
- * @param v The number to write
- */
-inline
-void strShort(char *f, unsigned int v)
-{
-    unsigned char v1 = v&0xFF;
-    unsigned char v2 = (v>>8)&0xFF;
-
-    f[ 0 ] = v2;
-    f[ 1 ] = v1;
-}
+/** strLong writes a long to a string, in the big-endian format of blorb files
+ * @param f The string to write the number to (4 bytes)
+ * @param v The number to write
+ * @see readLong
+ */
+void strLong(char *f, unsigned int v)
+{
+    unsigned char v1 = v&0xFF;
+    unsigned char v2 = (v>>8)&0xFF;
+    unsigned char v3 = (v>>16)&0xFF;
+    unsigned char v4 = (v>>24)&0xFF;
 
-/** write_id writes a string to a file as a blorb ID string (4 bytes, space padded)
- * @param f The file handle
- * @param s The string
- */
-void writeId(FILE *f, char *s)
-{
-    int i;
-    static const char sp = ' ';
-
-    for (i = 0; i < strlen( s ); i++) {
-        fwrite( &s[ i ], 1, 1, f );
-    }
-
-    for (; i < BlorbIdLen; i++) {
-        fwrite( &sp, 1, 1, f );
-    }
-}
+    f[ 0 ] = v4;
+    f[ 1 ] = v3;
+    f[ 2 ] = v2;
+    f[ 3 ] = v1;
+}
 
 /**
- * strId writes a blorb identifier to a string
+ * strId writes a blorb identifier to a string (4 bytes, space padded)
  * @param f The string
  * @param s The blorb identifier
-*/
-void strId(char *f, char *s)
-{
-    unsigned int i;
+*/
+void strId(char *f, const char *s)
+{
+    unsigned int i;
     static const char sp = ' ';
     unsigned int lenId = strlen( s );
 
     if ( lenId > BlorbIdLen ) {
         lenId = BlorbIdLen;
-    }
-
-    for ( i=0; i < lenId; i++) {
+    }
+
+    for ( i=0; i < lenId; i++) {
         f[ i ] = s[ i ];
-    }
-    for (; i < BlorbIdLen; i++) {
+    }
+    for (; i < BlorbIdLen; i++) {
         f[ i ] = sp;
-    }
+    }
 }
 
 /**
@@ -520,141 +1054,211 @@ void copyId(char *dest, const char *org)
 }
 
 /**
- * inferType - fills the chunk->Type field. Also sets status->isGlulx
+ * inferType - fills the chunk->Type field, from the registry of types.
+ * Also sets status->isGlulx
  * @param chunk The chunk data to fill in with the type
+ * @param use The use of the chunk
  * @param fileName
  * @see Chunk
+ * @see ResourceTypes
  */
 
-void inferType(Chunk * chunk, const char * fileName, Status * status)
+void inferType(Chunk * chunk, Usages use, const char * fileName, Status * status)
 {
-    char * ext = getFileNameExt( fileName );
+    char * ext = getFileNameExt( &status->arena, fileName );
+    const ResourceType * type = findResourceType( use, strtolower( ext ) );
 
-    strtolower( ext );
-
-    if ( !strcmp( ext, JpgFilesExt ) ) {
-        copyId( chunk->Type, PictureChunkTypes[ JPG ] );
-    }
-    else
-    if ( !strcmp( ext, PngFilesExt ) ) {
-        copyId( chunk->Type, PictureChunkTypes[ PNG ] );
-    }
-    else
-    if ( !strcmp( ext, OggFilesExt ) ) {
-        copyId( chunk->Type, SoundChunkTypes[ OGG ] );
+    if ( type == NULL ) {
+        sprintf( status->msg, "%d: unrecognized file extension '%s' in '%s'\n",
+                 status->lineNumber, ext, fileName
+        );
+        manageError( status->msg );
     }
-    else
-    if ( !strcmp( ext, ModFilesExt ) ) {
-        copyId( chunk->Type, SoundChunkTypes[ MOD ] );
-    }
-    else
-    if ( !strcmp( ext, AifFilesExt ) ) {
-        copyId( chunk->Type, SoundChunkTypes[ AIFF ] );
-    }
-    else
-    if ( !strcmp( ext, Z5FilesExt ) ) {
-        copyId( chunk->Type, ExecutableChunkTypes[ ZCOD ] );
-        status->isGlulx = false;
-    }
-    else
-    if ( !strcmp( ext, Z8FilesExt ) ) {
-        copyId( chunk->Type, ExecutableChunkTypes[ ZCOD ] );
-        status->isGlulx = false;
-    }
-    else
-    if ( !strcmp( ext, GlulxFilesExt ) ) {
-        copyId( chunk->Type, ExecutableChunkTypes[ GLUL ] );
-        status->isGlulx = true;
-    }
-    else
-    if ( !strcmp( ext, IfictionFilesExt ) ) {
-        copyId( chunk->Type, ChunkUsages[ IFmd ]  );
-    }
-    else {
-        sprintf( status->msg, "%d: unrecognized file extension '%s' in '%s'\n",
-                 status->lineNumber, ext, fileName
-        );
-        manageError( status->msg );
+
+    copyId( chunk->Type, type->Type );
+
+    if ( type->Use == Exec ) {
+        status->isGlulx = !strcmp( type->Type, "GLUL" );
     }
 
-
-    free( ext );
     return;
 }
 
-char * createNameFromFile(Usages use, const char * fileName)
+char * createNameFromFile(Arena * arena, Usages use, const char * fileName)
 {
-    const unsigned int lenFileName = strlen( fileName );
-    char * toret = (char *) my_malloc( lenFileName * 2 );
-    char * shortName = getShortFileName( fileName );
+    char * shortName = getShortFileName( arena, fileName );
+    char * toret = (char *) arenaAlloc( arena,
+                                strlen( VblePrefixes[ use ] ) + strlen( shortName ) + 1 );
 
     shortName[ 0 ] = toupper( shortName[ 0 ] );
 
     strcpy( toret, VblePrefixes[ use ] );
     strcat( toret, shortName );
 
-    free( shortName );
     return toret;
 }
 
-void writeBliEntry(FILE * bli, Usages use, unsigned int res, const char * id, const char * fileName)
+void writeBliEntry(FILE * bli, Arena * arena, Usages use, unsigned int res, const char * id, const char * fileName,
+                   unsigned int width, unsigned int height)
 {
-    char * vbleName;
+    const char * vbleName;
     char * shortFileName;
     char * fileNameExt;
 
     if ( bli != NULL
       && ( use == Pict
-        || use == Snd ) )
+        || use == Snd
+        || use == Data ) )
     {
         if ( id == NULL
           || *id == 0 )
         {
-             vbleName = createNameFromFile( use, fileName );
+             vbleName = createNameFromFile( arena, use, fileName );
         }
-        else vbleName = my_strdup( id );
+        else vbleName = id;
 
-        shortFileName = getShortFileName( fileName );
-        fileNameExt = getFileNameExt( fileName );
+        shortFileName = getShortFileName( arena, fileName );
+        fileNameExt = getFileNameExt( arena, fileName );
 
-        fprintf( bli, "Constant %s %d;\t! %s: '%s.%s'\n",
+        fprintf( bli, "Constant %s %d;\t! %s: '%s%s%s'\n",
                             vbleName, res, ChunkUsages[ use ],
-                            shortFileName, fileNameExt
+                            shortFileName, ( *fileNameExt != 0 ) ? "." : "", fileNameExt
         );
 
-        free( shortFileName );
-        free( fileNameExt );
-        free( vbleName );
+        /* Dimensions of pictures, so layouts can be computed without loading them */
+        if ( width > 0 ) {
+            fprintf( bli, "Constant %s%s %u;\nConstant %s%s %u;\n",
+                            vbleName, WidthSuffix, width,
+                            vbleName, HeightSuffix, height
+            );
+        }
     }
 
     return;
 }
 
-void writeBliHeader(Status * status)
+/**
+ * getBliDate gets the date for the header of the bli file: the current one,
+ * or the one in SOURCE_DATE_EPOCH (in UTC), or none in reproducible builds.
+ * @param status The status
+ * @param strDate The string for the date, of ShortStringSize chars, empty if none
+ * @return true if the date does not depend on when the build is done
+ */
+bool getBliDate(Status * status, char * strDate)
 {
-    if ( status->bli != NULL ) {
-        time_t dateTime  = time( NULL );
-        struct tm * date = localtime( &dateTime );
-        char strDate[BufferSize];
+    const char * epoch = getenv( SourceDateEpochVar );
+    time_t dateTime  = time( NULL );
+    struct tm * date = NULL;
+    char * end;
 
+    if ( epoch != NULL
+      && *epoch != 0 )
+    {
+        dateTime = (time_t) strtol( epoch, &end, 10 );
+
+        if ( *end != 0 ) {
+            sprintf( status->msg, "invalid %s: '%s'", SourceDateEpochVar, epoch );
+            manageError( status->msg );
+        }
+
+        date = gmtime( &dateTime );
+    }
+    else
+    if ( !status->reproducible ) {
+        date = localtime( &dateTime );
+    }
+
+    *strDate = 0;
+
+    if ( date != NULL ) {
         sprintf( strDate, "%02d/%02d/%04d %02d:%02d:%02d",
                     date->tm_mday, date->tm_mon + 1, date->tm_year + 1900,
                     date->tm_hour, date->tm_min, date->tm_sec
         );
+    }
 
+    return ( status->reproducible
+          || ( epoch != NULL && *epoch != 0 ) );
+}
+
+/**
+ * writeBliHeader writes the comments and the message at the beginning of the bli file
+ * @param status The status
+ * @param strDate The date the file is generated on, or an empty string
+ */
+void writeBliHeader(Status * status, const char * strDate)
+{
+    if ( status->bli != NULL ) {
         /* Write the bli header */
         fprintf( status->bli, "! Resources include file for Inform\n"
-                      "! Generated by %s (%s) %s on %s\n\n",
-                        status->myName, AppName, Version, strDate
+                      "%s%s (%s) %s%s%s\n\n",
+                        BliGeneratedPrefix, status->myName, AppName, Version,
+                        ( *strDate != 0 ) ? " on " : "", strDate
         );
 
         fprintf( status->bli,
-                 "message \"Including resources file by %s, on %s\";\n\n",
-                 AppName, strDate
+                 "%s%s%s%s\";\n\n",
+                 BliMessagePrefix, AppName,
+                 ( *strDate != 0 ) ? ", on " : "", strDate
         );
     }
 }
 
+/**
+ * readBliLine reads the next line of a bli file to compare,
+ * skipping the lines with the date
+ * @return the line, or NULL at the end of the file
+ */
+char * readBliLine(FILE * f, char * line)
+{
+    char * toret;
+
+    do {
+        toret = fgets( line, BufferSize, f );
+    } while( toret != NULL
+          && ( !strncmp( line, BliGeneratedPrefix, strlen( BliGeneratedPrefix ) )
+            || !strncmp( line, BliMessagePrefix, strlen( BliMessagePrefix ) ) ) );
+
+    return toret;
+}
+
+/**
+ * isSameBli compares two bli files, but for the date they were generated on
+ * @return true if both exist and have the same constants, false otherwise
+ */
+bool isSameBli(const char * fileName1, const char * fileName2)
+{
+    char line1[ BufferSize ];
+    char line2[ BufferSize ];
+    char * l1;
+    char * l2;
+    FILE * in1 = fopen( fileName1, "rt" );
+    FILE * in2 = fopen( fileName2, "rt" );
+    bool toret = ( in1 != NULL && in2 != NULL );
+
+    while ( toret ) {
+        l1 = readBliLine( in1, line1 );
+        l2 = readBliLine( in2, line2 );
+
+        toret = ( ( l1 == NULL && l2 == NULL )
+               || ( l1 != NULL && l2 != NULL && !strcmp( l1, l2 ) ) );
+
+        if ( l1 == NULL ) {
+            break;
+        }
+    }
+
+    if ( in1 != NULL ) {
+        fclose( in1 );
+    }
+
+    if ( in2 != NULL ) {
+        fclose( in2 );
+    }
+
+    return toret;
+}
+
 unsigned int assignResNumber(Usages use, Status * stat)
 {
     unsigned int toret = UsageError;
@@ -671,6 +1275,10 @@ unsigned int assignResNumber(Usages use, Status * stat)
         toret = ( stat->nextChunkForSnds )++;
     }
     else
+    if ( use == Data ) {
+        toret = ( stat->nextChunkForData )++;
+    }
+    else
     if ( use == IFmd ) {
         toret = ( stat->nextChunkForMeta )++;
     }
@@ -678,35 +1286,33 @@ unsigned int assignResNumber(Usages use, Status * stat)
     return toret;
 }
 
-char * prepareFileName(char ** buffer, Status * status)
+/**
+ * prepareFileName completes the file name in buffer with the path of the res file,
+ * if it is relative.
+ * @return the complete file name, allocated in the arena
+ */
+char * prepareFileName(char * buffer, Status * status)
 {
     char * toret;
 
-    strTrim( *buffer, FieldDelimiters );
+    strTrim( buffer, FieldDelimiters );
 
-    if ( isRelativePath( *buffer ) ) {
-        toret = makeCompletePath( status->path, *buffer );
-        free( *buffer );
-        *buffer = NULL;
+    if ( isRelativePath( buffer ) ) {
+        toret = makeCompletePath( &status->arena, status->path, buffer );
     }
-    else toret = *buffer;
+    else toret = arenaStrdup( &status->arena, buffer );
 
     return toret;
 }
 
-bool isId(const char *id)
+bool isId(const char *id, Status * status)
 {
     bool toret = false;
-    const char * ptr = id;
+    const unsigned char * ptr = (const unsigned char *) id;
 
-    if ( isalpha( *ptr )
-     ||  strchr( allowedSymbolsInIds, *ptr ) != NULL )
-    {
+    if ( status->charClasses[ *ptr ] & ClassIdStart ) {
         for(++ptr; *ptr != 0; ++ptr) {
-            if ( !isalpha( *ptr )
-              && !isdigit( *ptr )
-              && strchr( allowedSymbolsInIds, *ptr ) == NULL )
-            {
+            if ( !( status->charClasses[ *ptr ] & ClassId ) ) {
                 break;
             }
         }
@@ -745,51 +1351,214 @@ char * describeChunk(Chunk *chunk, Status * status, bool complete)
 }
 
 /**
- * readChunk reads one entry from a res control file and loads a chunk from it
- * It does also write each entry in the bli file
+ * addChunk adds a new, empty chunk at the end of the chunk table.
+ * The table grows geometrically, so adding chunks is amortized constant time.
+ * Beware: pointers to chunks are invalidated when the table grows.
+ * @return a pointer to the new chunk
+ */
+Chunk * addChunk(Status * status)
+{
+    Chunk * toret;
+
+    if ( status->numberOfChunks == status->maxChunks ) {
+        status->maxChunks = ( status->maxChunks + 1 ) * 2;
+        status->BlorbChunks = (Chunk *) my_realloc( status->BlorbChunks,
+                                                    status->maxChunks * sizeof( Chunk ) );
+    }
+
+    toret = &( status->BlorbChunks[ ( status->numberOfChunks )++ ] );
+    memset( toret, 0, sizeof( Chunk ) );
+
+    return toret;
+}
+
+/**
+ * addEntry adds a new entry to the table of entries of the res file
+ */
+ResEntry * addEntry(Status * status, int * maxEntries)
+{
+    if ( status->numberOfEntries == *maxEntries ) {
+        *maxEntries = ( *maxEntries + 1 ) * 2;
+        status->entries = (ResEntry *) my_realloc( status->entries,
+                                                   *maxEntries * sizeof( ResEntry ) );
+    }
+
+    return &( status->entries[ ( status->numberOfEntries )++ ] );
+}
+
+/**
+ * splitField marks the end of the field starting at *ptr,
+ * and moves *ptr to the beginning of the next field
+ * @return the field
+ */
+char * splitField(char ** ptr, const unsigned char * classes)
+{
+    char * toret = *ptr;
+    char * pos = *ptr;
+
+    while ( *pos != 0 && !( classes[ (unsigned char) *pos ] & ClassField ) ) {
+        ++pos;
+    }
+
+    if ( *pos != 0 ) {
+        *pos++ = 0;
+    }
+
+    while ( classes[ (unsigned char) *pos ] & ClassField ) {
+        ++pos;
+    }
+
+    *ptr = pos;
+    return toret;
+}
+
+/**
+ * isPreloadMarker decides whether a field is the preload marker,
+ * ignoring case
+ */
+bool isPreloadMarker(const char * field)
+{
+    const char * marker = PreloadMarker;
+
+    for(; *field != 0 && tolower( (unsigned char) *field ) == *marker; ++field, ++marker);
+
+    return ( *field == 0 && *marker == 0 );
+}
+
+/**
+ * tokenizeRes reads the whole res file in one go, and splits it into entries,
+ * in a single pass. Each line is either blank, a comment, or an entry:
+ * an optional preload marker, a use, an optional id, and a file name.
+ * If there is an id, the file name
+ * is the rest of the line; otherwise, it is the next field, and it can only
+ * be followed by a comment.
+ * @see ResEntry
+ */
+void tokenizeRes(Status * status)
+{
+    const unsigned char * classes = status->charClasses;
+    int maxEntries = 0;
+    unsigned int line = 0;
+    long length = 0;
+    char * contents;
+    char * ptr;
+    char * field;
+    char * end;
+    ResEntry * entry;
+
+    /* Read the whole file */
+    if ( fseek( status->in, 0, SEEK_END ) != 0
+      || ( length = ftell( status->in ) ) < 0
+      || fseek( status->in, 0, SEEK_SET ) != 0 )
+    {
+        manageError( "reading Blorb Resources Control File" );
+    }
+
+    contents = (char *) arenaAlloc( &status->arena, length + 1 );
+
+    if ( fread( contents, 1, length, status->in ) != (size_t) length ) {
+        manageError( "reading Blorb Resources Control File" );
+    }
+
+    contents[ length ] = 0;
+    status->bytesRead += length;
+
+    /* Split it into entries */
+    for(ptr = contents; *ptr != 0; ) {
+        ++line;
+
+        /* Find the end of the line, and mark it */
+        for(end = ptr; *end != 0 && !( classes[ (unsigned char) *end ] & ClassLine ); ++end);
+
+        if ( *end != 0 ) {
+            *end = 0;
+            ++end;
+
+            /* \r\n is only one end of line */
+            if ( *( end - 1 ) == '\r' && *end == '\n' ) {
+                ++end;
+            }
+        }
+
+        /* Skip blank lines and comments */
+        while ( classes[ (unsigned char) *ptr ] & ClassField ) {
+            ++ptr;
+        }
+
+        if ( *ptr == 0
+          || ( classes[ (unsigned char) *ptr ] & ClassComment ) )
+        {
+            ptr = end;
+            continue;
+        }
+
+        entry = addEntry( status, &maxEntries );
+        entry->Line = line;
+        entry->Id = NULL;
+
+        /* Use, maybe after the preload marker */
+        entry->Use = splitField( &ptr, classes );
+        entry->Preload = isPreloadMarker( entry->Use );
+
+        if ( entry->Preload ) {
+            entry->Use = splitField( &ptr, classes );
+        }
+
+        if ( *ptr == 0 ) {
+            sprintf( status->msg, "%d: missing file name", line );
+            manageError( status->msg );
+        }
+
+        /* Id or file name */
+        field = splitField( &ptr, classes );
+
+        if ( isId( field, status ) ) {
+            /* The file name is the rest of the line */
+            entry->Id = field;
+            entry->Path = strTrim( ptr, FieldDelimiters );
+        } else {
+            entry->Path = field;
+
+            if ( *ptr != 0
+              && !( classes[ (unsigned char) *ptr ] & ClassComment ) )
+            {
+                sprintf( status->msg, "%d: unexpected text after file name: '%s'", line, ptr );
+                manageError( status->msg );
+            }
+        }
+
+        if ( *( entry->Path ) == 0 ) {
+            sprintf( status->msg, "%d: missing file name", line );
+            manageError( status->msg );
+        }
+
+        ptr = end;
+    }
+}
+
+/**
+ * readChunk prepares a chunk from one entry of the res control file.
+ * The resource file is not opened: only its name is recorded.
+ * @see loadChunks
+ * @see writeBli
  * @see Chunk
- * @param f The file handle
- * @param bli the file handle of the bli file
+ * @param entry The entry of the res file
 */
-Chunk * readChunk(Status * status)
+Chunk * readChunk(Status * status, const ResEntry * entry)
 {
-    unsigned int buflen = ShortStringSize;
     char * fileName     = NULL;
     Usages use          = UsageError;
-    char * id           = NULL;
-    int c               = EOF;
-    FILE * f            = status->in;
-
-    /* Malloc a new chunk */
-    Chunk * toret = (Chunk *) my_malloc( sizeof( Chunk ) );
-    char * buffer = (char *) my_malloc( buflen );
 
-    /* Read in the res file line */
-    /* skip commented lines */
-    skipDelimiters( f );
-    c = fgetc( f );
-    while ( strchr( CommentCharacters, c ) != NULL ) {
-        freadLine( f, &buffer, &buflen, LineDelimiters );
-        skipDelimiters( f );
-        c = fgetc( f );
-    }
-
-    /* End of file? */
-    if ( c == EOF ) {
-        free( buffer );
-        free( toret );
-        toret = NULL;
-        goto End;
-    }
+    /* Add a new chunk */
+    Chunk * toret = addChunk( status );
 
     /* Use */
-    ungetc( c, f );
-    freadLine( f, &buffer, &buflen, FieldDelimiters );
-    use = cnvtToUsages( buffer );
+    status->lineNumber = entry->Line;
+    use = cnvtToUsages( entry->Use );
     copyId( toret->Use, ChunkUsages[ use ] );
 
     /* Chk use */
-    if ( !chkUse( toret->Use, status ) ) {
+    if ( !chkUse( entry->Use, status ) ) {
         manageError( status->msg );
     }
 
@@ -814,49 +1583,205 @@ Chunk * readChunk(Status * status)
      /* Assign id */
     toret->Res = assignResNumber( use, status );
 
-    /* Abort if anything is wrong */
-    skipDelimiters( f );
-    if ( feof( f ) ) {
-        manageError( "unexpected end of file" );
-    }
+    /* get file name */
+    fileName = prepareFileName( entry->Path, status );
+
+    /* set the type of the chunk */
+    inferType( toret, use, fileName, status );
 
-    /* Read the rest of the line, if needed */
-    freadLine( f, &buffer, &buflen, FieldDelimiters );
-    if ( isId( buffer ) ) {
-        id = buffer;
-        buffer = NULL;
-        buflen = 0;
-        skipDelimiters( f );
-        freadLine( f, &buffer, &buflen, LineDelimiters );
-        strTrim( buffer, FieldDelimiters );
+    if ( !chkType( use, toret->Type, status ) ) {
+        manageError( status->msg );
     }
 
-    /* get file name */
-    fileName = prepareFileName( &buffer, status );
-
-    /* set the type of the chunk */
-    inferType( toret, fileName, status );
-    chkType( use, toret->Type, status );
-
-    /* Write the .bli entry, provided it is not the cover */
+    /* Remember the cover, which is always needed at startup */
+    toret->Preload = entry->Preload;
+
     if ( status->thereIsCover
       && status->numberOfChunks == status->coverChunk )
     {
         status->coverId = toret->Res;
-    }
-    else {
-        writeBliEntry( status->bli, use, toret->Res, id, fileName );
+        toret->Preload = true;
     }
 
-    /* open file name */
-    FILE * in = fopen( fileName, "rb" );
-
-    if ( in == NULL ) {
-        sprintf( status->msg, "%d: can't open file '%s'\n", status->lineNumber, fileName );
-        free( fileName );
-        free( toret );
-        toret = NULL;
-        fileName = NULL;
+    /* The file is sized and validated later, by loadChunks() */
+    toret->FileName = fileName;
+    toret->Line = entry->Line;
+
+    return toret;
+}
+
+/**
+ * chkHeader checks the first bytes of a resource file against its type,
+ * with the validator in the registry of types.
+ * @param chunk The chunk, with its type and length already known
+ * @param header The first bytes of the file
+ * @param len The number of bytes in header
+ * @param in The file, for reading headers beyond the first bytes
+ * @return true if the header matches the type (or it can't be checked)
+ * @see ResourceTypes
+ */
+bool chkHeader(Chunk * chunk, const unsigned char * header, size_t len, FILE * in)
+{
+    const ResourceType * type = findResourceTypeById( UsageError, chunk->Type );
+
+    return ( type == NULL
+          || type->Validator == NULL
+          || type->Validator( chunk, header, len, in ) );
+}
+
+/**
+ * getModificationTime returns the modification time of a file,
+ * in nanoseconds, so a change in the same second is not missed
+ * @param info The information about the file, from stat()
+ */
+long long getModificationTime(const struct stat * info)
+{
+    long long toret = info->st_mtime * 1000000000LL;
+
+#if defined( __APPLE__ )
+    toret += info->st_mtimespec.tv_nsec;
+#elif !defined( _WIN32 )
+    toret += info->st_mtim.tv_nsec;
+#endif
+
+    return toret;
+}
+
+/**
+ * loadChunk opens a resource file, gets its size and validates its header.
+ * It only modifies the chunk given, so it can be run in parallel.
+ * @param chunk The chunk to load
+ */
+void loadChunk(Chunk * chunk)
+{
+    unsigned char header[ HeaderCheckLen ];
+    struct stat fileInfo;
+    size_t headerLen;
+    FILE * in = fopen( chunk->FileName, "rb" );
+
+    chunk->Load = LoadCantOpen;
+
+    if ( in != NULL ) {
+        if ( fstat( fileno( in ), &fileInfo ) == 0 ) {
+            /* Lengths of chunks are 32 bits */
+            if ( (unsigned long long) fileInfo.st_size > MaxIffLength ) {
+                chunk->Load = LoadTooLarge;
+            } else {
+                chunk->Length = fileInfo.st_size;
+                chunk->MTime = getModificationTime( &fileInfo );
+                headerLen = fread( header, 1, HeaderCheckLen, in );
+
+                if ( chkHeader( chunk, header, headerLen, in ) ) {
+                    chunk->Load = LoadOk;
+                }
+                else chunk->Load = LoadBadHeader;
+            }
+        }
+
+        fclose( in );
+    }
+}
+
+#ifdef HAVE_THREADS
+/** The chunks to be loaded, shared among all workers */
+typedef struct _LoadQueue {
+    Status * status;
+    int nextChunk;
+    pthread_mutex_t lock;
+} LoadQueue;
+
+/**
+ * loadWorker loads chunks from the queue, until it is empty
+ * @param queue The LoadQueue shared among all workers
+ */
+void * loadWorker(void * queue)
+{
+    LoadQueue * q = (LoadQueue *) queue;
+    int i;
+
+    for(;;) {
+        pthread_mutex_lock( &q->lock );
+        i = ( q->nextChunk )++;
+        pthread_mutex_unlock( &q->lock );
+
+        if ( i >= q->status->numberOfChunks ) {
+            break;
+        }
+
+        loadChunk( &( q->status->BlorbChunks[ i ] ) );
+    }
+
+    return NULL;
+}
+#endif
+
+/**
+ * loadChunks opens, sizes and validates all resource files,
+ * using status->jobs threads if possible.
+ * Errors are then reported in the order of the res file,
+ * missing files being only a warning when only the bli file is generated.
+ * The result is the same no matter the number of threads.
+ */
+void loadChunks(Status * status)
+{
+    int i;
+    int numWorkers = status->jobs;
+
+    if ( numWorkers > status->numberOfChunks ) {
+        numWorkers = status->numberOfChunks;
+    }
+
+#ifdef HAVE_THREADS
+    if ( numWorkers > 1 ) {
+        pthread_t * workers = (pthread_t *) my_malloc( numWorkers * sizeof( pthread_t ) );
+        LoadQueue queue;
+
+        queue.status = status;
+        queue.nextChunk = 1;
+        pthread_mutex_init( &queue.lock, NULL );
+
+        for(i = 0; i < numWorkers; i++) {
+            if ( pthread_create( &workers[ i ], NULL, loadWorker, &queue ) != 0 ) {
+                manageError( "can't create loader threads" );
+            }
+        }
+
+        for(i = 0; i < numWorkers; i++) {
+            pthread_join( workers[ i ], NULL );
+        }
+
+        pthread_mutex_destroy( &queue.lock );
+        free( workers );
+    }
+    else
+#endif
+    for(i = 1; i < status->numberOfChunks; i++) {
+        loadChunk( &( status->BlorbChunks[ i ] ) );
+    }
+
+    /* Report errors, in order */
+    for(i = 1; i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        if ( chunk->Load == LoadOk ) {
+            continue;
+        }
+
+        if ( chunk->Load == LoadBadHeader ) {
+            sprintf( status->msg, "%d: contents of '%s' do not match type '%s'\n",
+                     chunk->Line, chunk->FileName, chunk->Type
+            );
+            manageError( status->msg );
+        }
+
+        if ( chunk->Load == LoadTooLarge ) {
+            sprintf( status->msg, "%d: '%s' is larger than %lu bytes, the limit of blorb chunks\n",
+                     chunk->Line, chunk->FileName, MaxIffLength
+            );
+            manageError( status->msg );
+        }
+
+        sprintf( status->msg, "%d: can't open file '%s'\n", chunk->Line, chunk->FileName );
 
         // Manage error or warning
         if ( status->onlyBli ) {
@@ -866,77 +1791,628 @@ Chunk * readChunk(Status * status)
         } else {
             manageError( status->msg );
         }
-
-        // Jump to the end (next entry)
-        goto End;
     }
+}
+
+/**
+ * getChunkRank returns the place of a chunk in a layout:
+ * chunks of lower rank go first
+ * @see arrangeChunks
+ */
+int getChunkRank(const Chunk * chunk, Layouts layout)
+{
+    int toret = 1;
 
+    if ( !strcmp( chunk->Type, "RIdx" ) ) {
+        toret = 0;
+    }
+    else
+    if ( layout == LayoutExecLast ) {
+        if ( !strcmp( chunk->Use, ChunkUsages[ Exec ] ) ) {
+            toret = 2;
+        }
+    }
+    else
+    if ( layout == LayoutStartup ) {
+        if ( !strcmp( chunk->Use, ChunkUsages[ Exec ] ) ) {
+            toret = 1;
+        }
+        else
+        if ( !strcmp( chunk->Type, ChunkUsages[ Fspc ] )
+          || !strcmp( chunk->Type, ResolutionId ) )
+        {
+            toret = 2;
+        }
+        else
+        if ( chunk->Preload ) {
+            toret = 3;
+        }
+        else toret = 4;
+    }
 
-    /* read in file contents */
-    fseek( in, 0, SEEK_END );
-    toret->Length = ftell( in );
-    toret->Data = freadBlock( in, 0, toret->Length );
-    fclose( in );
-
-    End:
-    free( fileName );
     return toret;
 }
 
-void initReport(Status * status)
-{
-    status->report = (char *) my_malloc( ShortStringSize * status->numberOfChunks );
-    *( status->report ) = 0;
-}
-
 /**
- * buildIndex builds the index chunk for a blorb file, loading all other chunks.
- * It does also write the .bli file
- * @param blorb file handle
+ * arrangeChunks sorts the chunk table following the layout,
+ * keeping the order of the res file among chunks of the same rank.
+ * In the startup layout, the index, the executable, the cover and the
+ * preload chunks go first, so interpreters can start reading less.
+ * In the execlast layout, the executable goes last, so updating it is fast.
+ * @see getChunkRank
+ * @see updateExec
  */
-void buildIndex(Status * status)
+void arrangeChunks(Status * status)
 {
     int i;
-    int n = 0;
+    int j = 0;
+    int rank;
+    const int MaxRank = 4;
+    Chunk * chunks = (Chunk *) my_malloc( ( status->numberOfChunks + 1 ) * sizeof( Chunk ) );
+
+    for(rank = 0; rank <= MaxRank; rank++) {
+        for(i = 0; i < status->numberOfChunks; i++) {
+            if ( getChunkRank( &( status->BlorbChunks[ i ] ), status->layout ) == rank ) {
+                chunks[ j++ ] = status->BlorbChunks[ i ];
+            }
+        }
+    }
+
+    memcpy( status->BlorbChunks, chunks, status->numberOfChunks * sizeof( Chunk ) );
+    free( chunks );
+}
+
+/**
+ * writeBli writes the bli file, with a constant for each picture and sound,
+ * and, if asked for, the dimensions of each picture. It must be called after loadChunks().
+ * There is one chunk for each entry of the res file, after the index chunk
+ */
+void writeBli(Status * status)
+{
+    int i;
+    const ResEntry * entry;
+    char strDate[ ShortStringSize ];
+    bool reproducible;
+    bool unchanged;
+
+    if ( status->noBli ) {
+        return;
+    }
+
+    reproducible = getBliDate( status, strDate );
+
+    /* It is written to a temporary file, which replaces the bli file if it changed */
+    status->bliTempName = makeCompletePath( &status->arena, status->bliName, TempSuffix );
+    status->bli = fopen( status->bliTempName, "wt" );
+
+    if ( status->bli == NULL ) {
+        sprintf( status->msg, "can't open bli file: '%s'", status->bliTempName );
+        manageError( status->msg );
+    }
+
+    writeBliHeader( status, strDate );
+
+    for(i = 0; i < status->numberOfEntries; i++) {
+        entry = &( status->entries[ i ] );
+
+        /* Only pictures, sounds and data get a constant (not the cover, which is Fspc) */
+        writeBliEntry( status->bli, &status->arena, cnvtToUsages( entry->Use ),
+                       status->BlorbChunks[ i + 1 ].Res,
+                       entry->Id, status->BlorbChunks[ i + 1 ].FileName,
+                       status->dimensions ? status->BlorbChunks[ i + 1 ].Width : 0,
+                       status->BlorbChunks[ i + 1 ].Height
+        );
+    }
+
+    fflush( status->bli );
+    status->bytesWritten += ftell( status->bli );
+    fclose( status->bli );
+    status->bli = NULL;
+
+    /* Keep the previous bli file (and its modification time) if nothing changed.
+       In reproducible builds, the header must be the same too, so the bli file
+       does not depend on the one of a previous build */
+    if ( reproducible ) {
+        unchanged = fcmpFiles( status->bliTempName, status->bliName );
+    }
+    else unchanged = isSameBli( status->bliTempName, status->bliName );
+
+    if ( unchanged ) {
+        remove( status->bliTempName );
+
+        if ( status->verbose ) {
+            fprintf( status->log, "\t'%s' is unchanged.\n", status->bliName );
+        }
+    } else {
+        remove( status->bliName );
+
+        if ( rename( status->bliTempName, status->bliName ) != 0 ) {
+            sprintf( status->msg, "can't rename '%s' to '%s'", status->bliTempName, status->bliName );
+            manageError( status->msg );
+        }
+    }
+}
+
+/**
+ * reportChunks shows all chunks, after building the index
+ * or after writing them to the blorb
+ */
+void reportChunks(Status * status, bool written)
+{
+    int i;
+
+    if ( written ) {
+        for(i = 0; i < status->numberOfChunks; i++) {
+            Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+            if ( chunk->Original != 0 ) {
+                fprintf( status->log, "\t\tChunk %04d(%s)\tshared with chunk %04d.\n",
+                         i + 1, describeChunk( chunk, status, false ), chunk->Original + 1
+                );
+            } else {
+                fprintf( status->log, "\t\tChunk %04d(%s)\twritten.\n",
+                         i + 1, describeChunk( chunk, status, false )
+                );
+            }
+        }
+    } else {
+        for(i = 1; i < status->numberOfChunks; i++) {
+            fprintf( status->log, "\t\t%s\n",
+                     describeChunk( &( status->BlorbChunks[ i ] ), status, true )
+            );
+        }
+    }
+
+    fprintf( status->log, "\n" );
+}
+
+/**
+ * getChunkSize returns the number of bytes a chunk takes in the blorb file,
+ * including its header (if any) and padding.
+ * It is 64 bits, since a chunk of 4 GiB does not fit in 32 bits with its header.
+ * @param chunk The chunk
+ * @return The size of the chunk in the file
+ */
+unsigned long long getChunkSize(const Chunk * chunk)
+{
+    unsigned long long toret = (unsigned long long) chunk->Length + ( chunk->Length % 2 );
+
+    if ( strcmp( chunk->Type, "FORM" ) ) {
+        toret += ChunkHeaderLen;
+    }
+
+    return toret;
+}
+
+/**
+ * getChunkPadding returns the size of the filler chunk needed before a chunk,
+ * so its contents start at a multiple of the alignment.
+ * Only chunks at least as long as the alignment are aligned.
+ * A filler chunk is at least as long as a chunk header.
+ * @param chunk The chunk
+ * @param pos The position the chunk would be written to
+ * @param alignment The alignment, or 0 for none
+ * @return The number of bytes of the filler chunk, or 0
+ */
+unsigned long getChunkPadding(const Chunk * chunk, unsigned long long pos, unsigned long alignment)
+{
+    unsigned long toret = 0;
+    unsigned long long dataPos = pos;
+
+    if ( strcmp( chunk->Type, "FORM" ) ) {
+        dataPos += ChunkHeaderLen;
+    }
+
+    if ( alignment > 0
+      && chunk->Length >= alignment
+      && ( dataPos % alignment ) != 0 )
+    {
+        toret = alignment - ( dataPos % alignment );
+
+        while ( toret < ChunkHeaderLen ) {
+            toret += alignment;
+        }
+    }
+
+    return toret;
+}
+
+/**
+ * cmpChunksBySize compares two chunks (given by pointers) by type and length,
+ * and then by position in the blorb, for qsort
+ */
+int cmpChunksBySize(const void * a, const void * b)
+{
+    const Chunk * chunk1 = *( (const Chunk **) a );
+    const Chunk * chunk2 = *( (const Chunk **) b );
+    int toret = strcmp( chunk1->Type, chunk2->Type );
+
+    if ( toret == 0 ) {
+        toret = ( chunk1->Length > chunk2->Length ) - ( chunk1->Length < chunk2->Length );
+    }
+
+    if ( toret == 0 ) {
+        toret = ( chunk1 > chunk2 ) - ( chunk1 < chunk2 );
+    }
+
+    return toret;
+}
+
+/**
+ * cmpChunksByHash compares two chunks (given by pointers) by the hash
+ * of their contents, and then by position in the blorb, for qsort
+ */
+int cmpChunksByHash(const void * a, const void * b)
+{
+    const Chunk * chunk1 = *( (const Chunk **) a );
+    const Chunk * chunk2 = *( (const Chunk **) b );
+    int toret = ( chunk1->Hash > chunk2->Hash ) - ( chunk1->Hash < chunk2->Hash );
+
+    if ( toret == 0 ) {
+        toret = ( chunk1 > chunk2 ) - ( chunk1 < chunk2 );
+    }
+
+    return toret;
+}
+
+/**
+ * isSameContents decides whether two resource files, of the same type
+ * and length, have the same contents. The same file has always the same contents;
+ * otherwise, all bytes are compared.
+ */
+bool isSameContents(Chunk * chunk1, Chunk * chunk2)
+{
+    return ( !strcmp( chunk1->FileName, chunk2->FileName )
+          || fcmpFiles( chunk1->FileName, chunk2->FileName ) );
+}
+
+/**
+ * dedupGroup finds the duplicates in a group of resources, sorted by position
+ * in the blorb, which can only have the same contents as earlier ones.
+ * Each one is compared with the resources before it that are not duplicates.
+ * @param group The resources
+ * @param n The number of resources
+ */
+void dedupGroup(Status * status, Chunk ** group, int n)
+{
+    int k;
+    int m;
+
+    for(k = 1; k < n; k++) {
+        for(m = 0; m < k; m++) {
+            if ( group[ m ]->Original == 0
+              && isSameContents( group[ m ], group[ k ] ) )
+            {
+                group[ k ]->Original = group[ m ] - status->BlorbChunks;
+                ++( status->numberOfDuplicates );
+                status->bytesDeduplicated += getChunkSize( group[ k ] );
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * dedupChunks finds resources with the same contents, so they share
+ * only one chunk in the blorb: the first one. The others are not written,
+ * and their entries in the index point to the first one.
+ * Only resources of the same type and length are compared: in groups of
+ * more than two, each file is hashed once, and then only files with
+ * the same hash are compared, so this is O(n log n) for n resources.
+ */
+void dedupChunks(Status * status)
+{
+    int i;
+    int j;
+    int k;
+    int m;
+    int n = 0;
+    Chunk ** sorted = (Chunk **) my_malloc( ( status->numberOfChunks + 1 ) * sizeof( Chunk * ) );
+
+    /* Sort resources by type and length */
+    for(i = 0; i < status->numberOfChunks; i++) {
+        if ( status->BlorbChunks[ i ].FileName != NULL ) {
+            sorted[ n++ ] = &( status->BlorbChunks[ i ] );
+        }
+    }
+
+    qsort( sorted, n, sizeof( Chunk * ), cmpChunksBySize );
+
+    /* Compare resources inside each group of the same type and length */
+    for(i = 0; i < n; i = j) {
+        for(j = i + 1; j < n; j++) {
+            if ( sorted[ j ]->Length != sorted[ i ]->Length
+              || strcmp( sorted[ j ]->Type, sorted[ i ]->Type ) )
+            {
+                break;
+            }
+        }
+
+        if ( j - i == 2 ) {
+            dedupGroup( status, sorted + i, 2 );
+        }
+        else
+        if ( j - i > 2 ) {
+            /* Hash each file once, and compare only files with the same hash */
+            for(k = i; k < j; k++) {
+                if ( sorted[ k ]->Hash == 0
+                  && !fhashFile( sorted[ k ]->FileName, &sorted[ k ]->Hash ) )
+                {
+                    sorted[ k ]->Hash = 0;
+                }
+            }
+
+            qsort( sorted + i, j - i, sizeof( Chunk * ), cmpChunksByHash );
+
+            for(k = i; k < j; k = m) {
+                for(m = k + 1; m < j && sorted[ m ]->Hash == sorted[ k ]->Hash; m++);
+
+                dedupGroup( status, sorted + k, m - k );
+            }
+        }
+    }
+
+    free( sorted );
+
+    if ( status->verbose
+      && status->numberOfDuplicates > 0 )
+    {
+        fprintf( status->log, "\n\tDuplicated resources: %d (%llu bytes saved)\n",
+                 status->numberOfDuplicates, status->bytesDeduplicated
+        );
+    }
+}
+
+/**
+ * addResolutionChunk adds the Reso chunk, with the standard window size
+ * (status->windowWidth x status->windowHeight), no limits for the window,
+ * and a ratio of 1/1 without limits for each picture,
+ * so pictures are shown at their size in the standard window.
+ */
+void addResolutionChunk(Status * status)
+{
+    int i;
+    int numPicts = 0;
+    char * dp;
+    Chunk * reso;
+
+    for(i = 1; i < status->numberOfChunks; i++) {
+        if ( !strcmp( status->BlorbChunks[ i ].Use, ChunkUsages[ Pict ] ) ) {
+            ++numPicts;
+        }
+    }
+
+    reso = addChunk( status );
+    strcpy( reso->Use, "0" );
+    strcpy( reso->Type, ResolutionId );
+    reso->Res = ++( status->nextChunkForMeta );
+    reso->Length = ResoHeaderLen + ( numPicts * ResoEntryLen );
+    reso->Data = dp = (char *) arenaAlloc( &status->arena, reso->Length );
+    memset( reso->Data, 0, reso->Length );
+
+    /* Standard window size. Minimum and maximum sizes are 0: no limits */
+    strLong( dp, status->windowWidth );
+    strLong( dp + 4, status->windowHeight );
+    dp += ResoHeaderLen;
+
+    /* Ratio 1/1. Minimum and maximum ratios are 0/0: no limits */
+    for(i = 1; i < status->numberOfChunks; i++) {
+        if ( !strcmp( status->BlorbChunks[ i ].Use, ChunkUsages[ Pict ] ) ) {
+            strLong( dp, status->BlorbChunks[ i ].Res );
+            strLong( dp + 4, 1 );
+            strLong( dp + 8, 1 );
+            dp += ResoEntryLen;
+        }
+    }
+}
+
+/**
+ * addDescriptionsChunk adds the RDes chunk, with a textual description
+ * of each picture and sound: its file name and, for pictures, its dimensions
+ */
+void addDescriptionsChunk(Status * status)
+{
+    int i;
+    int numEntries = 0;
+    unsigned long length = 4;
+    char * dp;
+    char * ext;
+    Chunk * rdes;
+
+    /* Compute the descriptions, and the length of the chunk */
+    char ** descriptions = (char **) arenaAlloc( &status->arena,
+                                                 ( status->numberOfChunks + 1 ) * sizeof( char * ) );
+
+    for(i = 1; i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        descriptions[ i ] = NULL;
+
+        if ( strcmp( chunk->Use, ChunkUsages[ Pict ] )
+          && strcmp( chunk->Use, ChunkUsages[ Snd ] ) )
+        {
+            continue;
+        }
+
+        ext = getFileNameExt( &status->arena, chunk->FileName );
+
+        if ( chunk->Width > 0 ) {
+            sprintf( status->msg, "%s%s%s (%ux%u)",
+                     getShortFileName( &status->arena, chunk->FileName ),
+                     ( *ext != 0 ) ? "." : "", ext,
+                     chunk->Width, chunk->Height
+            );
+        } else {
+            sprintf( status->msg, "%s%s%s",
+                     getShortFileName( &status->arena, chunk->FileName ),
+                     ( *ext != 0 ) ? "." : "", ext
+            );
+        }
+
+        descriptions[ i ] = arenaStrdup( &status->arena, status->msg );
+        length += IndexEntryLen + strlen( descriptions[ i ] );
+        ++numEntries;
+    }
+
+    /* Number of entries, and then usage, number, length and text of each one */
+    rdes = addChunk( status );
+    strcpy( rdes->Use, "0" );
+    strcpy( rdes->Type, DescriptionsId );
+    rdes->Res = ++( status->nextChunkForMeta );
+    rdes->Length = length;
+    rdes->Data = dp = (char *) arenaAlloc( &status->arena, length );
+
+    strLong( dp, numEntries );
+    dp += 4;
+
+    for(i = 1; i < status->numberOfChunks - 1; i++) {
+        if ( descriptions[ i ] != NULL ) {
+            unsigned int len = strlen( descriptions[ i ] );
+
+            strId( dp, status->BlorbChunks[ i ].Use );
+            strLong( dp + 4, status->BlorbChunks[ i ].Res );
+            strLong( dp + 8, len );
+            memcpy( dp + IndexEntryLen, descriptions[ i ], len );
+            dp += IndexEntryLen + len;
+        }
+    }
+}
+
+/**
+ * placeChunks computes the offset of every chunk in the blorb file,
+ * fills in the offsets in the index chunk and the total length of the file.
+ * It is called at the end of buildIndex(), when all lengths are known,
+ * so the blorb file can be written in one forward pass, and a blorb too
+ * large for the 32 bits of IFF offsets is found before anything is written.
+ * @see buildIndex
+ */
+void placeChunks(Status * status)
+{
+    int i;
+    unsigned long long pos = BlorbHeaderLen;
+    unsigned long padding;
+    char * dp = status->BlorbChunks[ 0 ].Data + 4;
+
+    for(i = 0; i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        if ( chunk->Original != 0 ) {
+            chunk->Offset = status->BlorbChunks[ chunk->Original ].Offset;
+        } else {
+            /* The index is never aligned: it must be the first chunk */
+            padding = ( i > 0 ) ? getChunkPadding( chunk, pos, status->alignment ) : 0;
+
+            /* Offsets and the length of the FORM are 32 bits:
+               below this limit, all of them fit */
+            if ( pos + padding + getChunkSize( chunk ) > MaxBlorbLength ) {
+                sprintf( status->msg, "%d: the blorb would be larger than %llu bytes, "
+                                      "the limit of blorb files, with '%s'",
+                         chunk->Line, MaxBlorbLength,
+                         ( chunk->FileName != NULL ) ? chunk->FileName : chunk->Type
+                );
+                manageError( status->msg );
+            }
+
+            chunk->Padding = padding;
+            chunk->Offset = pos + padding;
+            pos = chunk->Offset + getChunkSize( chunk );
+        }
+
+        /* Write the offset in its entry of the index chunk */
+        if ( strcmp( chunk->Use, "0" ) ) {
+            strLong( dp + 8, chunk->Offset );
+            dp += IndexEntryLen;
+        }
+    }
+
+    status->blorbLength = pos;
+}
+
+#ifdef HAVE_INOTIFY
+/**
+ * reportWatchedFiles sends the files of the project to the watcher:
+ * the res file, and the file of each resource, one per line.
+ */
+void reportWatchedFiles(Status * status)
+{
+    int i;
+    FILE * f = fdopen( status->watchFd, "w" );
+
+    if ( f != NULL ) {
+        fprintf( f, "%s\n", status->inName );
+
+        for(i = 0; i < status->numberOfChunks; i++) {
+            if ( status->BlorbChunks[ i ].FileName != NULL ) {
+                fprintf( f, "%s\n", status->BlorbChunks[ i ].FileName );
+            }
+        }
+
+        fclose( f );
+    }
+
+    status->watchFd = -1;
+}
+#endif
+
+/**
+ * buildIndex builds the index chunk for a blorb file: it parses the res file,
+ * sizes and validates all other chunks (the .bli file is written by writeBli()
+ * once they are known), adds the chunks of metadata, and places them all.
+ * Nothing of the blorb file is written yet.
+ * @param status The status
+ */
+void buildIndex(Status * status)
+{
+    int i;
+    int n = 0;
     char *dp;
     Chunk * chunk = NULL;
 
-    /* Start bli file */
-    writeBliHeader( status );
+    /* Prepare index chunk */
+    chunk = addChunk( status );
+    strcpy( chunk->Type, "RIdx");
+    strcpy( chunk->Use,  "0" );
 
-    /* Prepare index chunk */
-    status->BlorbChunks[ 0 ]= (Chunk *) my_malloc( sizeof( Chunk ) );
-    strcpy( status->BlorbChunks[ 0 ]->Type, "RIdx");
-    strcpy( status->BlorbChunks[ 0 ]->Use,  "0" );
-    status->numberOfChunks = 1;
+    /* Read all the entries, and prepare their chunks */
+    startPhase( status, PhaseParse );
+    tokenizeRes( status );
 
-    /* Load all the chunks */
-    skipDelimiters( status->in );
-
-    if ( !feof( status->in ) ) {
-        do {
-            chunk = readChunk( status );
-            if ( chunk != NULL ) {
-                status->lineNumber++;
+    for(i = 0; i < status->numberOfEntries; i++) {
+        readChunk( status, &( status->entries[ i ] ) );
+    }
+    endPhase( status, PhaseParse );
+
+#ifdef HAVE_INOTIFY
+    if ( status->watchFd >= 0 ) {
+        reportWatchedFiles( status );
+    }
+#endif
 
-                /* Find out how many resources there are */
-                if ( strcmp( chunk->Use, "0" ) ) {
-                    n++;
-                }
+    /* Size and validate all resource files */
+    startPhase( status, PhaseLoad );
+    loadChunks( status );
+    endPhase( status, PhaseLoad );
 
-                status->BlorbChunks[ status->numberOfChunks ] = chunk;
-                ++( status->numberOfChunks );
-                skipDelimiters( status->in );
-            }
-        } while( !feof( status->in ) );
+    /* Write the bli file */
+    startPhase( status, PhaseBli );
+    writeBli( status );
+    endPhase( status, PhaseBli );
+
+    startPhase( status, PhaseIndex );
+
+    /* Find out how many resources there are */
+    for(i = 1; i < status->numberOfChunks; i++) {
+        if ( strcmp( status->BlorbChunks[ i ].Use, "0" ) ) {
+            n++;
+        }
     }
 
     /* Is there a cover? Prepare cover chunk */
     if ( status->thereIsCover ) {
-        char * buffer = my_malloc( BlorbIdLen );
+        char * buffer = arenaAlloc( &status->arena, BlorbIdLen );
 
         /* Create new chunk */
-        Chunk * cover = status->BlorbChunks[ status->numberOfChunks ] = my_malloc( sizeof( Chunk ) );
+        Chunk * cover = addChunk( status );
 
         strcpy( cover->Use, "0" );
         strcpy( cover->Type, ChunkUsages[ Fspc ] );
@@ -945,303 +2421,2209 @@ void buildIndex(Status * status)
         strLong( buffer, status->coverId );
         cover->Data = buffer;
         cover->Length = 4;
-        ++( status->numberOfChunks );
+    }
+
+    /* Resolution and descriptions of pictures */
+    if ( status->windowWidth > 0 ) {
+        addResolutionChunk( status );
+    }
+
+    if ( status->describe ) {
+        addDescriptionsChunk( status );
+    }
+
+    /* Put the chunks in the order of the layout */
+    if ( status->layout != LayoutRes ) {
+        arrangeChunks( status );
+    }
+
+    /* Share chunks among resources with the same contents */
+    if ( status->dedup
+      && !status->onlyBli
+      && !status->devMap )
+    {
+        dedupChunks( status );
     }
 
     /* Write the length of the resource index chunk, and allocate its data space */
-    status->BlorbChunks[ 0 ]->Length = ( 12 * n ) + 4;
-    status->BlorbChunks[ 0 ]->Data=( char *) my_malloc( status->BlorbChunks[ 0 ]->Length );
-    status->indexOffsets = (unsigned long int *) my_malloc( n * sizeof( unsigned long int ) );
+    status->BlorbChunks[ 0 ].Length = ( IndexEntryLen * n ) + 4;
+    status->BlorbChunks[ 0 ].Data=( char *) arenaAlloc( &status->arena, status->BlorbChunks[ 0 ].Length );
 
     /* The first thing in the data chunk is the number of entries */
-    strLong( status->BlorbChunks[ 0 ]->Data, n );
+    strLong( status->BlorbChunks[ 0 ].Data, n );
+
+    /* Now, scroll through the chunks, noting each one in the index chunk.
+       Offsets are filled in later, by placeChunks() */
+    dp = status->BlorbChunks[ 0 ].Data + 4;
+    for(i = 1; i < status->numberOfChunks; i++) {
+        if ( strcmp( status->BlorbChunks[ i ].Use, "0" ) != 0 )
+        {
+            strId( dp, status->BlorbChunks[ i ].Use );
+            dp += 4;
+            strLong( dp, status->BlorbChunks[ i ].Res );
+            dp += 8;
+            ++( status->numberOfIndexEntries );
+        }
+    }
+
+    /* Compute the final position of all chunks */
+    if ( !status->onlyBli
+      && !status->devMap )
+    {
+        placeChunks( status );
+    }
 
-    /* Prepare the report */
-    if ( status->verbose ) {
-        initReport( status );
+    endPhase( status, PhaseIndex );
+}
+
+/**
+ * writeChunk writes one chunk to a file.
+ * Chunks coming from resource files are copied in blocks of bounded size,
+ * so memory use does not depend on the size of the resources.
+ */
+void writeChunk(OutBuffer * out, Chunk * chunk, Status * status)
+/* AIFF files are themselves chunks, so we just write their data, not
+ * their other info.
+ */
+{
+    static const char z = 0;
+    static const char zeros[ ShortStringSize ] = { 0 };
+    unsigned long fillerLength;
+
+    /* Write the filler chunk that aligns this one */
+    if ( chunk->Padding > 0 ) {
+        fillerLength = chunk->Padding - ChunkHeaderLen;
+        outBufferWriteId( out, FillerId );
+        outBufferWriteInt( out, fillerLength );
+
+        while ( fillerLength > 0 ) {
+            unsigned long blockLength = ( fillerLength < ShortStringSize ) ? fillerLength : ShortStringSize;
+
+            outBufferWrite( out, zeros, blockLength );
+            fillerLength -= blockLength;
+        }
+    }
+
+    if ( strcmp( chunk->Type, "FORM" ) ) {
+         outBufferWriteId ( out, chunk->Type );
+         outBufferWriteInt( out, chunk->Length );
+    }
+
+    if ( chunk->Data != NULL ) {
+        outBufferWrite( out, chunk->Data, chunk->Length );
+    }
+    else
+    if ( !outBufferFlush( out ) ) {
+        manageError( "writing blorb file" );
+    }
+    else
+    if ( chunk->Reused ) {
+        unsigned long dataOffset = chunk->OldOffset;
+
+        if ( strcmp( chunk->Type, "FORM" ) ) {
+            dataOffset += ChunkHeaderLen;
+        }
+
+        if ( !fcopyBlock( out->f, status->oldBlorb, dataOffset, chunk->Length ) ) {
+            sprintf( status->msg, "can't copy '%s' from the previous blorb", chunk->FileName );
+            manageError( status->msg );
+        }
+    }
+    else
+    if ( !fcopyFile( out->f, chunk->FileName, chunk->Length ) ) {
+        sprintf( status->msg, "can't copy file '%s'", chunk->FileName );
+        manageError( status->msg );
+    }
+
+    /* Pad chunks of odd length */
+    if ( chunk->Length % 2 ) {
+        outBufferWrite( out, &z, 1 );
+    }
+}
+
+/** generateBlorb generates a blorb from a res file. Requires the index to be already built
+ * The file is written sequentially, so it can be a pipe.
+ * @see buildIndex
+ * @param in res file handle
+ * @param out destination file handle
+ */
+void generateBlorb(Status * status)
+{
+    int i;
+    OutBuffer out;
+
+    /* Write the IFF header */
+    outBufferInit( &out, status->out, BufferSize );
+    outBufferWriteId( &out, "FORM" );
+    outBufferWriteInt( &out, status->blorbLength - 8 );
+    outBufferWriteId( &out, "IFRS" );
+
+    /* The index should be already built */
+    for(i = 0; i < status->numberOfChunks; i++) {
+        /* Resources with the same contents as a previous one are not written */
+        if ( status->BlorbChunks[ i ].Original != 0 ) {
+            continue;
+        }
+
+        /* Write the chunk to the file */
+        writeChunk( &out, &( status->BlorbChunks[ i ] ), status );
+
+        if ( status->BlorbChunks[ i ].FileName != NULL ) {
+            status->bytesRead += status->BlorbChunks[ i ].Length;
+        }
+    }
+
+    if ( !outBufferRelease( &out ) ) {
+        manageError( "writing blorb file" );
+    }
+
+    status->bytesWritten += status->blorbLength;
+}
+
+/**
+ * cmpManifestEntries compares two manifest entries by path, for qsort & bsearch
+ */
+int cmpManifestEntries(const void * a, const void * b)
+{
+    return strcmp( ( (const ManifestEntry *) a )->Path,
+                   ( (const ManifestEntry *) b )->Path );
+}
+
+/**
+ * getManifestName returns the name of the manifest for the output file
+ * @return a new string, allocated in the arena
+ */
+char * getManifestName(Status * status)
+{
+    return makeCompletePath( &status->arena, status->outName, ManifestSuffix );
+}
+
+/**
+ * readManifest loads the manifest of the previous build, and opens the
+ * previous blorb file, provided both exist and are consistent: the blorb
+ * must have the length and the modification time it had when the manifest
+ * was written, so a blorb built later by other means is not trusted.
+ * @return true if the previous build can be reused, false otherwise
+ */
+bool readManifest(Status * status)
+{
+    char * manifestName = getManifestName( status );
+    FILE * f = fopen( manifestName, "rt" );
+    char signature[ ShortStringSize ];
+    char header[ BlorbIdLen ];
+    char * path = NULL;
+    unsigned int pathLen = 0;
+    unsigned long long blorbLength;
+    long long blorbTime;
+    int version;
+    int maxEntries = 0;
+    ManifestEntry entry;
+    struct stat blorbInfo;
+    struct stat manifestInfo;
+
+    if ( f == NULL ) {
+        return false;
+    }
+
+    if ( fstat( fileno( f ), &manifestInfo ) == 0 ) {
+        status->manifestTime = getModificationTime( &manifestInfo );
+    }
+
+    /* Check the signature, and the blorb file it belongs to */
+    if ( fscanf( f, "%511s %d %llu %lld", signature, &version, &blorbLength, &blorbTime ) != 4
+      || strcmp( signature, ManifestSignature )
+      || version != ManifestVersion
+      || stat( status->outName, &blorbInfo ) != 0
+      || (unsigned long long) blorbInfo.st_size != blorbLength
+      || getModificationTime( &blorbInfo ) != blorbTime )
+    {
+        fclose( f );
+        return false;
+    }
+
+    /* Read the entries: offset, length, mtime, hash, path */
+    while ( fscanf( f, "%lu %lu %lld %llx ",
+                    &entry.Offset, &entry.Length, &entry.MTime, &entry.Hash ) == 4 )
+    {
+        freadLine( f, &path, &pathLen, LineDelimiters );
+        entry.Path = arenaStrdup( &status->arena, path );
+
+        if ( status->manifestSize == maxEntries ) {
+            maxEntries = ( maxEntries + 1 ) * 2;
+            status->manifest = (ManifestEntry *) my_realloc( status->manifest,
+                                                maxEntries * sizeof( ManifestEntry ) );
+        }
+
+        status->manifest[ ( status->manifestSize )++ ] = entry;
+    }
+
+    free( path );
+    fclose( f );
+
+    qsort( status->manifest, status->manifestSize, sizeof( ManifestEntry ), cmpManifestEntries );
+
+    /* Open the previous blorb */
+    status->oldBlorb = fopen( status->outName, "rb" );
+
+    if ( status->oldBlorb == NULL
+      || fread( header, 1, BlorbIdLen, status->oldBlorb ) != BlorbIdLen
+      || memcmp( header, "FORM", BlorbIdLen ) )
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * isChunkAt checks that the previous blorb has the header of a chunk
+ * at the offset given in the manifest: its type and length
+ * (FORM chunks are the files themselves, with their own header).
+ * @param chunk The chunk to reuse
+ * @param offset The offset of the chunk in the previous blorb
+ */
+bool isChunkAt(Status * status, const Chunk * chunk, unsigned long offset)
+{
+    char header[ ChunkHeaderLen ];
+    char type[ BlorbIdLen ];
+    bool isForm = !strcmp( chunk->Type, "FORM" );
+
+    strId( type, chunk->Type );
+
+    return ( fseeko( status->oldBlorb, offset, SEEK_SET ) == 0
+          && fread( header, 1, ChunkHeaderLen, status->oldBlorb ) == ChunkHeaderLen
+          && !memcmp( header, type, BlorbIdLen )
+          && readLong( header + 4 ) == ( isForm ? chunk->Length - 8 : chunk->Length ) );
+}
+
+/**
+ * matchManifest decides which chunks can be reused from the previous blorb.
+ * A chunk is reused if its file has the same size and modification time,
+ * or the same size and contents, as in the previous build,
+ * and its header is found where the manifest says.
+ * The modification time is not enough for files modified when the manifest
+ * was written or later: they could have changed again within the resolution
+ * of the file system, so their contents are compared.
+ * @return true if a file was reused with a different modification time
+ */
+bool matchManifest(Status * status)
+{
+    int i;
+    bool toret = false;
+    ManifestEntry key;
+    ManifestEntry * entry;
+
+    for(i = 0; i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        if ( chunk->FileName == NULL ) {
+            continue;
+        }
+
+        key.Path = chunk->FileName;
+        entry = (ManifestEntry *) bsearch( &key, status->manifest, status->manifestSize,
+                                           sizeof( ManifestEntry ), cmpManifestEntries );
+
+        if ( entry == NULL
+          || entry->Length != chunk->Length )
+        {
+            continue;
+        }
+
+        if ( entry->MTime == chunk->MTime
+          && chunk->MTime < status->manifestTime )
+        {
+            chunk->Hash = entry->Hash;
+            chunk->Reused = true;
+        }
+        else
+        if ( fhashFile( chunk->FileName, &chunk->Hash ) ) {
+            chunk->Reused = ( entry->Hash != 0
+                           && entry->Hash == chunk->Hash );
+            toret = toret || chunk->Reused;
+        }
+
+        if ( chunk->Reused
+          && !isChunkAt( status, chunk, entry->Offset ) )
+        {
+            chunk->Reused = false;
+        }
+
+        if ( chunk->Reused ) {
+            chunk->OldOffset = entry->Offset;
+        }
+    }
+
+    return toret;
+}
+
+/**
+ * isUpToDate decides whether the previous blorb is exactly the one to build:
+ * all chunks are reused at the same place, and the chunks generated by bresc
+ * (index, cover) are the same.
+ * @see placeChunks
+ */
+bool isUpToDate(Status * status)
+{
+    int i;
+    int numFileChunks = 0;
+    char * buffer;
+    struct stat blorbInfo;
+    bool toret = ( fstat( fileno( status->oldBlorb ), &blorbInfo ) == 0 );
+
+    toret = toret && ( (unsigned long long) blorbInfo.st_size == status->blorbLength );
+
+    for(i = 0; toret && i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        if ( chunk->FileName != NULL ) {
+            toret = ( chunk->Reused && chunk->OldOffset == chunk->Offset );
+            ++numFileChunks;
+        }
+        else
+        if ( chunk->Data != NULL ) {
+            buffer = (char *) my_malloc( chunk->Length );
+            toret = ( fseeko( status->oldBlorb, chunk->Offset + ChunkHeaderLen, SEEK_SET ) == 0
+                   && fread( buffer, 1, chunk->Length, status->oldBlorb ) == chunk->Length
+                   && !memcmp( buffer, chunk->Data, chunk->Length ) );
+            free( buffer );
+        }
+    }
+
+    return ( toret && numFileChunks == status->manifestSize );
+}
+
+/**
+ * writeManifest writes the manifest of the blorb file just built,
+ * with the hash of the contents of each file, so a file whose modification
+ * time changed but not its contents (a checkout, a touch) is reused later.
+ * Files are only hashed if their hash is not known yet.
+ * The blorb file must be already closed, so its modification time is final.
+ */
+void writeManifest(Status * status)
+{
+    int i;
+    char * manifestName = getManifestName( status );
+    FILE * f;
+    struct stat blorbInfo;
+
+    if ( stat( status->outName, &blorbInfo ) != 0 ) {
+        remove( manifestName );
+        return;
+    }
+
+    f = fopen( manifestName, "wt" );
+
+    if ( f == NULL ) {
+        sprintf( status->msg, "can't write manifest file: '%s'", manifestName );
+        manageWarning( status->msg );
+        return;
+    }
+
+    fprintf( f, "%s %d %llu %lld\n", ManifestSignature, ManifestVersion,
+             status->blorbLength, getModificationTime( &blorbInfo ) );
+
+    for(i = 0; i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        if ( chunk->FileName != NULL ) {
+            if ( chunk->Hash == 0
+              && !fhashFile( chunk->FileName, &chunk->Hash ) )
+            {
+                chunk->Hash = 0;
+            }
+
+            fprintf( f, "%lu %lu %lld %llx %s\n",
+                     chunk->Offset, chunk->Length, chunk->MTime, chunk->Hash,
+                     chunk->FileName
+            );
+        }
+    }
+
+    fclose( f );
+}
+
+/**
+ * prepareIncremental prepares an incremental build.
+ * When the previous blorb can be reused, the new one is written to a
+ * temporary file, which replaces the previous one in finishIncremental().
+ * @return true if the blorb file is already up to date, false otherwise
+ * @see finishIncremental
+ */
+bool prepareIncremental(Status * status)
+{
+    if ( !strcmp( status->outName, StdOutName ) ) {
+        manageError( "incremental builds can't write to the standard output" );
+    }
+
+    if ( readManifest( status ) ) {
+        bool newTimes = matchManifest( status );
+
+        if ( isUpToDate( status ) ) {
+            /* Remember the new modification times, so files are not hashed again */
+            if ( newTimes ) {
+                writeManifest( status );
+            }
+
+            return true;
+        }
+
+        status->tempName = makeCompletePath( &status->arena, status->outName, TempSuffix );
+    }
+    else
+    if ( status->oldBlorb != NULL ) {
+        fclose( status->oldBlorb );
+        status->oldBlorb = NULL;
+    }
+
+    return false;
+}
+
+/**
+ * finishIncremental replaces the previous blorb with the new one,
+ * writes the new manifest and reports which chunks were reused.
+ * @see prepareIncremental
+ */
+void finishIncremental(Status * status)
+{
+    int i;
+    int numReused = 0;
+    int numRebuilt = 0;
+    unsigned long bytesReused = 0;
+    unsigned long bytesRebuilt = 0;
+
+    fclose( status->out );
+    status->out = NULL;
+
+    if ( status->oldBlorb != NULL ) {
+        fclose( status->oldBlorb );
+        status->oldBlorb = NULL;
+    }
+
+    if ( status->tempName != NULL ) {
+        remove( status->outName );
+
+        if ( rename( status->tempName, status->outName ) != 0 ) {
+            sprintf( status->msg, "can't rename '%s' to '%s'", status->tempName, status->outName );
+            manageError( status->msg );
+        }
+    }
+
+    writeManifest( status );
+
+    for(i = 0; i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        if ( chunk->FileName != NULL
+          && chunk->Original == 0 )
+        {
+            if ( chunk->Reused ) {
+                ++numReused;
+                bytesReused += chunk->Length;
+            } else {
+                ++numRebuilt;
+                bytesRebuilt += chunk->Length;
+            }
+        }
+    }
+
+    fprintf( status->log, "\tChunks reused: %d (%lu bytes), rebuilt: %d (%lu bytes)\n",
+             numReused, bytesReused, numRebuilt, bytesRebuilt
+    );
+}
+
+/**
+ * hasFillerChunks finds out whether there are filler chunks, written by
+ * --align, among the chunks of a blorb file between two offsets
+ * @param f The blorb file
+ * @param pos The offset of the first chunk
+ * @param end The offset after the last chunk
+ */
+bool hasFillerChunks(FILE * f, unsigned long long pos, unsigned long long end)
+{
+    char header[ ChunkHeaderLen ];
+    unsigned long length;
+
+    while ( pos + ChunkHeaderLen <= end
+         && fseeko( f, pos, SEEK_SET ) == 0
+         && fread( header, 1, ChunkHeaderLen, f ) == ChunkHeaderLen )
+    {
+        if ( !memcmp( header, FillerId, BlorbIdLen ) ) {
+            return true;
+        }
+
+        length = readLong( header + 4 );
+        pos += ChunkHeaderLen + length + ( length % 2 );
+    }
+
+    return false;
+}
+
+/**
+ * updateExec replaces the executable chunk of an existing blorb file
+ * (status->outName) with a new story file (status->updateExec).
+ * If the executable is the last chunk, or its size does not change,
+ * it is just overwritten. Otherwise, the chunks after it are moved back,
+ * and the executable is put at the end, updating the index.
+ * Moved chunks are not aligned again: a warning is given if they were.
+ * Only the executable and the chunks after it are written.
+ */
+void updateExec(Status * status)
+{
+    FILE * f = fopen( status->outName, "r+b" );
+    char header[ BlorbHeaderLen ];
+    char * index = NULL;
+    char * entry = NULL;
+    char * dp;
+    unsigned int indexLength;
+    unsigned int numEntries;
+    unsigned int i;
+    unsigned long long fileEnd;
+    unsigned long execOffset;
+    unsigned long long oldSize;
+    unsigned long long newSize;
+    unsigned long newLength;
+    bool isLast;
+    Chunk exec;
+    OutBuffer out;
+    struct stat fileInfo;
+
+    if ( f == NULL ) {
+        sprintf( status->msg, "can't open blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    /* Load the new story file */
+    memset( &exec, 0, sizeof( Chunk ) );
+    exec.FileName = status->updateExec;
+    inferType( &exec, Exec, exec.FileName, status );
+
+    if ( !chkType( Exec, exec.Type, status ) ) {
+        manageError( status->msg );
+    }
+
+    loadChunk( &exec );
+
+    if ( exec.Load != LoadOk ) {
+        sprintf( status->msg, "can't use story file: '%s'", exec.FileName );
+        manageError( status->msg );
+    }
+
+    newLength = exec.Length;
+    newSize = getChunkSize( &exec );
+
+    /* Read the header and the index, which must be the first chunk */
+    if ( fread( header, 1, BlorbHeaderLen, f ) != BlorbHeaderLen
+      || memcmp( header, "FORM", BlorbIdLen )
+      || memcmp( header + 8, "IFRS", BlorbIdLen )
+      || fread( header, 1, ChunkHeaderLen, f ) != ChunkHeaderLen
+      || memcmp( header, "RIdx", BlorbIdLen ) )
+    {
+        sprintf( status->msg, "not a valid blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    indexLength = readLong( header + 4 );
+    index = (char *) my_malloc( indexLength + 4 );
+    memset( index, 0, 4 );
+
+    if ( fread( index, 1, indexLength, f ) != indexLength
+      || indexLength < 4 )
+    {
+        numEntries = 0;
+        indexLength = 0;
+    }
+    else numEntries = readLong( index );
+
+    if ( indexLength == 0
+      || numEntries * IndexEntryLen + 4 > indexLength )
+    {
+        sprintf( status->msg, "corrupted index in blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    /* Find the executable */
+    for(i = 0, dp = index + 4; i < numEntries; i++, dp += IndexEntryLen) {
+        if ( !memcmp( dp, "Exec", BlorbIdLen )
+          && readLong( dp + 4 ) == 0 )
+        {
+            entry = dp;
+            break;
+        }
+    }
+
+    if ( entry == NULL ) {
+        sprintf( status->msg, "no executable chunk in blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    /* Find out where the executable chunk is, and how big */
+    if ( fseeko( f, 4, SEEK_SET ) != 0
+      || fread( header, 1, 4, f ) != 4 )
+    {
+        sprintf( status->msg, "not a valid blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    fileEnd = readLong( header ) + 8ULL;
+
+    if ( fstat( fileno( f ), &fileInfo ) != 0
+      || fileEnd > (unsigned long long) fileInfo.st_size )
+    {
+        sprintf( status->msg, "truncated blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    execOffset = readLong( entry + 8 );
+
+    if ( fseeko( f, execOffset, SEEK_SET ) != 0
+      || fread( header, 1, ChunkHeaderLen, f ) != ChunkHeaderLen )
+    {
+        sprintf( status->msg, "corrupted executable chunk in blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    exec.Length = readLong( header + 4 );
+    oldSize = getChunkSize( &exec );
+
+    if ( execOffset + oldSize > fileEnd ) {
+        sprintf( status->msg, "corrupted executable chunk in blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+    exec.Length = newLength;
+    isLast = ( execOffset + oldSize == fileEnd );
+
+    /* The executable goes to the end of the file, unless it fits in its place */
+    if ( ( isLast ? execOffset : fileEnd - oldSize ) + newSize > MaxBlorbLength ) {
+        sprintf( status->msg, "the blorb would be larger than %llu bytes, "
+                              "the limit of blorb files, with '%s'",
+                 MaxBlorbLength, exec.FileName
+        );
+        manageError( status->msg );
+    }
+
+    /* Move the chunks after the executable, if needed */
+    if ( !isLast
+      && oldSize != newSize )
+    {
+        if ( hasFillerChunks( f, execOffset + oldSize, fileEnd ) ) {
+            sprintf( status->msg, "the chunks moved in '%s' are no longer aligned: "
+                                  "build the blorb again to align them",
+                     status->outName
+            );
+            manageWarning( status->msg );
+        }
+
+        if ( !fmoveBlock( f, execOffset + oldSize, execOffset, fileEnd - execOffset - oldSize ) ) {
+            sprintf( status->msg, "can't move chunks in blorb file: '%s'", status->outName );
+            manageError( status->msg );
+        }
+
+        for(i = 0, dp = index + 4; i < numEntries; i++, dp += IndexEntryLen) {
+            if ( readLong( dp + 8 ) > execOffset ) {
+                strLong( dp + 8, readLong( dp + 8 ) - oldSize );
+            }
+        }
+
+        fileEnd -= oldSize;
+        execOffset = fileEnd;
+        strLong( entry + 8, execOffset );
+
+        fseeko( f, BlorbHeaderLen + ChunkHeaderLen, SEEK_SET );
+        fwrite( index, 1, indexLength, f );
+        isLast = true;
+
+        if ( status->verbose ) {
+            fprintf( status->log, "\tExecutable chunk moved to the end.\n" );
+        }
+    }
+
+    /* Write the executable chunk */
+    if ( isLast ) {
+        fileEnd = execOffset + newSize;
+    }
+
+    fseeko( f, execOffset, SEEK_SET );
+    outBufferInit( &out, f, BufferSize );
+    writeChunk( &out, &exec, status );
+
+    if ( !outBufferRelease( &out ) ) {
+        manageError( "writing blorb file" );
+    }
+
+    /* Write the new length of the file */
+    fseeko( f, 4, SEEK_SET );
+    outBufferInit( &out, f, BlorbIdLen );
+    outBufferWriteInt( &out, fileEnd - 8 );
+
+    if ( !outBufferRelease( &out ) ) {
+        manageError( "writing blorb file" );
+    }
+
+    if ( !ftruncateFile( f, fileEnd ) ) {
+        sprintf( status->msg, "can't truncate blorb file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    fclose( f );
+    free( index );
+
+    /* The manifest for incremental builds is no longer valid */
+    remove( getManifestName( status ) );
+
+    fprintf( status->log, "\tExecutable chunk updated with '%s' (%lu bytes).\n",
+             exec.FileName, exec.Length
+    );
+}
+
+/**
+ * getTypeFileExt returns the usual file extension for a type of chunk
+ * (without padding spaces), the inverse of inferType()
+ * @param use The use of the chunk
+ * @param type The type of the chunk
+ * @see inferType
+ * @see ResourceTypes
+ */
+const char * getTypeFileExt(Usages use, const char * type)
+{
+    const ResourceType * toret = findResourceTypeById( use, type );
+
+    if ( toret == NULL
+      || *( toret->Ext ) == 0 )
+    {
+        return BinFilesExt;
+    }
+
+    return toret->Ext;
+}
+
+/**
+ * openBlorb opens an existing blorb file (status->inName), reading its index
+ * @see blorbOpenFile
+ */
+void openBlorb(Blorb * blorb, Status * status)
+{
+    BlorbResults result = blorbOpenFile( blorb, status->inName );
+
+    if ( result == BlorbCantOpen ) {
+        sprintf( status->msg, "can't open blorb file: '%s'", status->inName );
+        manageError( status->msg );
+    }
+    else
+    if ( result == BlorbBadHeader ) {
+        sprintf( status->msg, "not a valid blorb file: '%s'", status->inName );
+        manageError( status->msg );
+    }
+    else
+    if ( result == BlorbBadIndex ) {
+        sprintf( status->msg, "corrupted index in blorb file: '%s'", status->inName );
+        manageError( status->msg );
+    }
+}
+
+/**
+ * listBlorb shows the resources in the index of a blorb file (status->inName).
+ * Only the index and the header of each resource chunk are read
+ */
+void listBlorb(Status * status)
+{
+    Blorb blorb;
+    BlorbView view;
+    const BlorbResource * resource;
+    unsigned int i;
+
+    openBlorb( &blorb, status );
+
+    fprintf( status->log, "\n'%s': %lu bytes, %u resources\n\n\t%-4s %5s %10s %10s  Type\n",
+             status->inName, (unsigned long) blorb.length, blorb.numResources,
+             "Use", "Res", "Offset", "Length"
+    );
+
+    for(i = 0; i < blorb.numResources; i++) {
+        resource = &( blorb.resources[ i ] );
+
+        if ( !blorbGetChunk( &blorb, resource->Offset, &view ) ) {
+            sprintf( status->msg, "corrupted chunk for %s %u in blorb file: '%s'",
+                     resource->Use, resource->Res, status->inName
+            );
+            manageError( status->msg );
+        }
+
+        fprintf( status->log, "\t%-4s %5u %10lu %10lu  %s\n",
+                 resource->Use, resource->Res, resource->Offset, view.Length, view.Type
+        );
+    }
+
+    fprintf( status->log, "\n" );
+    blorbClose( &blorb );
+}
+
+/**
+ * extractChunk writes the contents of one resource of a blorb file (status->inName)
+ * to status->outName. If there is no output name, then it is built from
+ * the usage, the resource number and the type, as in "pic3.png".
+ * Only the index and the resource chunk are read
+ */
+void extractChunk(Status * status)
+{
+    Blorb blorb;
+    BlorbView view;
+    unsigned int res;
+    char * end;
+    Usages use = cnvtToUsages( status->extractUse );
+    FILE * out;
+
+    res = strtoul( status->extractRes, &end, 10 );
+
+    if ( use >= IFmd
+      || *( status->extractRes ) == 0
+      || *end != 0 )
+    {
+        sprintf( status->msg, "invalid resource to extract: '%s %s'",
+                 status->extractUse, status->extractRes
+        );
+        manageError( status->msg );
+    }
+
+    /* Find the resource */
+    openBlorb( &blorb, status );
+
+    if ( blorbFind( &blorb, ChunkUsages[ use ], res ) == NULL ) {
+        sprintf( status->msg, "resource %s %u not found in blorb file: '%s'",
+                 ChunkUsages[ use ], res, status->inName
+        );
+        manageError( status->msg );
+    }
+
+    if ( !blorbGetResource( &blorb, ChunkUsages[ use ], res, &view ) ) {
+        sprintf( status->msg, "corrupted chunk for %s %u in blorb file: '%s'",
+                 ChunkUsages[ use ], res, status->inName
+        );
+        manageError( status->msg );
+    }
+
+    /* Write it */
+    if ( status->outName == NULL ) {
+        sprintf( status->msg, "%s%u.%s", VblePrefixes[ use ], res, getTypeFileExt( use, view.Type ) );
+        status->outName = arenaStrdup( &status->arena, status->msg );
+    }
+
+    if ( !strcmp( status->outName, StdOutName ) ) {
+        out = stdout;
+    }
+    else out = fopen( status->outName, "wb" );
+
+    if ( out == NULL ) {
+        sprintf( status->msg, "can't open output file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    if ( fwrite( view.Data, 1, view.Length, out ) != view.Length
+      || fflush( out ) != 0 )
+    {
+        sprintf( status->msg, "writing file: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    if ( out != stdout ) {
+        fclose( out );
+    }
+
+    fprintf( status->log, "\t%s %u (%s, %lu bytes) extracted.\n",
+             ChunkUsages[ use ], res, view.Type, view.Length
+    );
+
+    blorbClose( &blorb );
+}
+
+void changeOutputFileExtension(Status * status)
+{
+    /* The output file name was given by the user */
+    if ( status->outName != NULL ) {
+        return;
+    }
+
+    if ( !status->isShortExtension ) {
+        if ( status->thereIsBib ) {
+            if ( status->isGlulx )
+                    status->outFileExt = BlorbGlulxExt;
+            else    status->outFileExt = BlorbZCodeExt;
+        }
+        else
+        if ( !status->isGlulx ) {
+            status->outFileExt = BlorbZCodeExt;
+        }
+    }
+
+    status->outName = changeFileNameExt( &status->arena, status->inName, status->outFileExt );
+}
+
+void cleanMemory(Status * status)
+{
+    /* Clean memory: all strings and chunk data live in the arena */
+    status->myName = NULL;
+    status->path = NULL;
+    status->tempName = status->bliTempName = status->updateExec = NULL;
+    status->outName = status->inName = status->bliName = NULL;
+
+    free( status->BlorbChunks );
+    status->BlorbChunks = NULL;
+    status->numberOfChunks = status->maxChunks = 0;
+
+    free( status->manifest );
+    status->manifest = NULL;
+    status->manifestSize = 0;
+    status->manifestTime = 0;
+
+    free( status->entries );
+    status->entries = NULL;
+    status->numberOfEntries = 0;
+
+    arenaRelease( &status->arena );
+
+    /* Close files */
+    if ( status->in != NULL ) {
+        fclose( status->in );
+    }
+
+    if ( status->out != NULL
+      && status->out != stdout )
+    {
+        fclose( status->out );
+    }
+
+    if ( status->oldBlorb != NULL ) {
+        fclose( status->oldBlorb );
+    }
+
+    if ( status->bli != NULL ) {
+        fclose( status->bli );
+    }
+}
+
+/**
+ * fprintJsonString writes a string as a JSON string literal
+ */
+void fprintJsonString(FILE * f, const char * str)
+{
+    const unsigned char * ptr = (const unsigned char *) str;
+
+    fputc( '"', f );
+
+    for(; *ptr != 0; ++ptr) {
+        if ( *ptr == '"'
+          || *ptr == '\\' )
+        {
+            fprintf( f, "\\%c", *ptr );
+        }
+        else
+        if ( *ptr < ' ' ) {
+            fprintf( f, "\\u%04x", *ptr );
+        }
+        else fputc( *ptr, f );
+    }
+
+    fputc( '"', f );
+}
+
+/**
+ * writeStats writes the statistics of the build: time spent in each phase,
+ * bytes read and written, peak memory, and the position of all chunks.
+ * Offsets are only known if the blorb was generated (or found up to date)
+ * @see Phases
+ */
+void writeStats(Status * status)
+{
+    int i;
+    double totalWall = 0;
+    double totalCpu = 0;
+    double throughput = 0;
+    bool placed = ( status->blorbLength > 0 );
+    unsigned long peakMemory = getPeakMemory();
+    FILE * f = stderr;
+
+    if ( status->statsName != NULL ) {
+        f = fopen( status->statsName, "wt" );
+
+        if ( f == NULL ) {
+            sprintf( status->msg, "can't open statistics file: '%s'", status->statsName );
+            manageError( status->msg );
+        }
+    }
+
+    for(i = 0; i < NumPhases; i++) {
+        totalWall += status->phaseWall[ i ];
+        totalCpu += status->phaseCpu[ i ];
+    }
+
+    if ( totalWall > 0 ) {
+        throughput = ( status->bytesRead + status->bytesWritten ) / totalWall;
+    }
+
+    if ( status->statsFormat == StatsJsonFormat ) {
+        fprintf( f, "{\n  \"input\": " );
+        fprintJsonString( f, status->inName );
+        fprintf( f, ",\n  \"output\": " );
+        fprintJsonString( f, status->outName );
+        fprintf( f, ",\n  \"phases\": {\n" );
+
+        for(i = 0; i < NumPhases; i++) {
+            fprintf( f, "    \"%s\": { \"wall\": %.6f, \"cpu\": %.6f }%s\n",
+                     PhaseNames[ i ], status->phaseWall[ i ], status->phaseCpu[ i ],
+                     ( i + 1 < NumPhases ) ? "," : ""
+            );
+        }
+
+        fprintf( f, "  },\n"
+                    "  \"total\": { \"wall\": %.6f, \"cpu\": %.6f },\n"
+                    "  \"bytesRead\": %llu,\n"
+                    "  \"bytesWritten\": %llu,\n"
+                    "  \"bytesDeduplicated\": %llu,\n"
+                    "  \"throughput\": %.0f,\n"
+                    "  \"peakMemoryKB\": %lu,\n"
+                    "  \"blorbLength\": %llu,\n"
+                    "  \"chunks\": [",
+                    totalWall, totalCpu,
+                    status->bytesRead, status->bytesWritten, status->bytesDeduplicated,
+                    throughput, peakMemory, status->blorbLength
+        );
+
+        for(i = 0; i < status->numberOfChunks; i++) {
+            Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+            fprintf( f, "%s\n    { \"type\": ", ( i > 0 ) ? "," : "" );
+            fprintJsonString( f, chunk->Type );
+            fprintf( f, ", \"use\": " );
+            fprintJsonString( f, chunk->Use );
+            fprintf( f, ", \"res\": %u, \"length\": %lu", chunk->Res, chunk->Length );
+
+            if ( placed ) {
+                fprintf( f, ", \"offset\": %lu", chunk->Offset );
+            }
+
+            if ( chunk->Original != 0 ) {
+                fprintf( f, ", \"sharedWith\": %u", chunk->Original );
+            }
+
+            if ( chunk->FileName != NULL ) {
+                fprintf( f, ", \"file\": " );
+                fprintJsonString( f, chunk->FileName );
+            }
+
+            fprintf( f, " }" );
+        }
+
+        fprintf( f, "\n  ]\n}\n" );
+    } else {
+        fprintf( f, "\nStatistics for '%s':\n\t%-8s%12s%12s\n",
+                 status->inName, "Phase", "Wall (s)", "CPU (s)"
+        );
+
+        for(i = 0; i < NumPhases; i++) {
+            fprintf( f, "\t%-8s%12.6f%12.6f\n",
+                     PhaseNames[ i ], status->phaseWall[ i ], status->phaseCpu[ i ]
+            );
+        }
+
+        fprintf( f, "\t%-8s%12.6f%12.6f\n\n"
+                    "\tBytes read: %llu\tBytes written: %llu\tThroughput: %.2f MiB/s\n"
+                    "\tBytes saved by sharing chunks: %llu\n"
+                    "\tPeak memory: %lu KiB\n\n"
+                    "\t%10s %10s  Type Use   Res  File\n",
+                    "total", totalWall, totalCpu,
+                    status->bytesRead, status->bytesWritten, throughput / ( 1024 * 1024 ),
+                    status->bytesDeduplicated,
+                    peakMemory,
+                    "Offset", "Length"
+        );
+
+        for(i = 0; i < status->numberOfChunks; i++) {
+            Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+            if ( placed ) {
+                fprintf( f, "\t%10lu", chunk->Offset );
+            }
+            else fprintf( f, "\t%10s", "-" );
+
+            fprintf( f, " %10lu  %-4s %-4s %4u  %s\n",
+                     chunk->Length, chunk->Type, chunk->Use, chunk->Res,
+                     ( chunk->FileName != NULL ) ? chunk->FileName : ""
+            );
+        }
+    }
+
+    if ( f != stderr ) {
+        fclose( f );
+    }
+}
+
+void strUsage(Status * status)
+{
+    sprintf( status->msg, "Usage is :\n"
+                    "\t%s [options] in-file [out-file]\n"
+                    "\t(out-file can be '%s', meaning the standard output)\n\n\tOptions:\n"
+                    "\t\t--%s     \tShows this help and ends.\n"
+                    "\t\t--%s\tShows version and ends.\n"
+                    "\t\t--%s  \tPrevents .bli file of being generated.\n"
+                    "\t\t--%s\tIt does only generate the .bli file, no blorb.\n"
+                    "\t\t--%s\tIt does only generate files with .blb extension.\n"
+                    "\t\t--%s N\tUses N threads for loading resources (default: cores).\n"
+                    "\t\t--%s\tReuses unchanged chunks from the previous blorb.\n"
+                    "\t\t--%s\tPuts the executable as the last chunk (--%s=%s).\n"
+                    "\t\t--%s=%s|%s|%s\tOrder of chunks: res file, startup first, executable last.\n"
+                    "\t\t--%s[=N]\tAligns chunks of N bytes or more to N bytes (default: %d).\n"
+                    "\t\t--%s story-file\tReplaces the executable in the blorb given as in-file.\n"
+                    "\t\t--%s WxH\tAdds a Reso chunk, for a standard window of WxH.\n"
+                    "\t\t--%s\tAdds a RDes chunk, describing pictures and sounds.\n"
+                    "\t\t--%s\tWrites the dimensions of pictures in the .bli file.\n"
+                    "\t\t--%s\tWrites resources with the same contents more than once.\n"
+                    "\t\t--%s\tLists the resources in the blorb given as in-file.\n"
+                    "\t\t--%s use num\tExtracts a resource from the blorb given as in-file.\n"
+                    "\t\t--%s[=%s|%s]\tShows timing, sizes and chunks of the build.\n"
+                    "\t\t--%s file\tWrites the statistics to file (default: stderr).\n"
+                    "\t\t--%s file\tBuilds in parallel the res files listed in file.\n"
+                    "\t\t(several res files can also be given instead of in-file)\n"
+                    "\t\t--%s\tBuilds again each time the res file or its resources change.\n"
+                    "\t\t--%s\tLeaves the date out of the .bli file (or uses %s).\n"
+                    "\t\t-%s\tWrites a dependency file for make, named after out-file (.%s).\n"
+                    "\t\t-%s file\tWrites the dependency file to file.\n"
+                    "\t\t--%s\tWrites a map of the resource files (.%s), instead of a blorb.\n"
+                    ,
+                    status->myName, StdOutName,
+                    OptHelp, OptVersion, OptNoBli, OptBliOnly, OptShortExt,
+                    OptJobs, OptIncremental, OptExecLast, OptLayout, LayoutNames[ LayoutExecLast ],
+                    OptLayout, LayoutNames[ LayoutRes ], LayoutNames[ LayoutStartup ], LayoutNames[ LayoutExecLast ],
+                    OptAlign, DefaultAlignment,
+                    OptUpdateExec,
+                    OptWindow, OptDescribe, OptDimensions, OptNoDedup, OptList, OptExtract,
+                    OptStats, StatsText, StatsJson, OptStatsFile,
+                    OptBatch, OptWatch, OptReproducible, SourceDateEpochVar,
+                    "MD", DepFileExt, "MF",
+                    OptDevMap, DevMapExt
+    );
+}
+
+/**
+ * getOptionValue returns the value of an option,
+ * given either as --option=value or as --option value
+ * @param argv The arguments of the program
+ * @param numArgs The number of arguments
+ * @param numOp The position of the option. Updated if the value is the next argument.
+ * @param status The status, for error messages
+ * @return a pointer to the value, inside argv
+ */
+char * getOptionValue(char *argv[], unsigned int numArgs, unsigned int * numOp, Status * status)
+{
+    char * toret = strchr( argv[ *numOp ], '=' );
+
+    if ( toret != NULL ) {
+        ++toret;
+    }
+    else
+    if ( ( *numOp ) + 1 < numArgs ) {
+        toret = argv[ ++( *numOp ) ];
+    }
+    else {
+        sprintf( status->msg, "missing value for option: '%s'", argv[ *numOp ] );
+        manageError( status->msg );
+    }
+
+    return toret;
+}
+
+unsigned int processOptions(char *argv[], int * argc, Status *status, bool *end)
+{
+    const unsigned int numArgs = *argc;
+    unsigned int numOp = 1;
+    unsigned int firstOp;
+    char * op;
+    char * ptr;
+    char * value;
+
+    for(; numOp < numArgs; ++numOp ) {
+        op = my_strdup( argv[ numOp ] );
+        strtolower( op );
+        ptr = op;
+        firstOp = numOp;
+
+        /* Pass all '-' */
+        while ( *ptr == '-' ) {
+            ++ptr;
+        }
+
+        /* Was any '-' present? */
+        if ( ptr == op ) {
+            free( op );
+            break;
+        }
+
+        /* Separate the value, if any */
+        value = strchr( ptr, '=' );
+        if ( value != NULL ) {
+            *value = 0;
+        }
+
+        /* Check options */
+        if ( !strcmp( ptr, OptNoBli ) ) {
+            status->noBli = true;
+        }
+        else
+        if ( !strcmp( ptr, OptVersion ) ) {
+            printf( "\n\n" );
+
+            *end = true;
+        }
+        else
+        if ( !strcmp( ptr, OptHelp ) ) {
+            strUsage( status );
+            printf( "\n%s\n", status->msg );
+
+            *end = true;
+        }
+        else
+        if ( !strcmp( ptr, OptBliOnly ) ) {
+            status->onlyBli = true;
+        }
+        else
+        if ( !strcmp( ptr, OptVerbose ) ) {
+            status->verbose = true;
+        }
+        else
+        if ( !strcmp( ptr, OptShortExt ) ) {
+            status->isShortExtension = true;
+        }
+        else
+        if ( !strcmp( ptr, OptJobs ) ) {
+            int jobs = atoi( getOptionValue( argv, numArgs, &numOp, status ) );
+
+            if ( jobs < 1 ) {
+                sprintf( status->msg, "invalid number of jobs: '%d'", jobs );
+                manageError( status->msg );
+            }
+
+            status->jobs = jobs;
+        }
+        else
+        if ( !strcmp( ptr, OptIncremental ) ) {
+            status->incremental = true;
+        }
+        else
+        if ( !strcmp( ptr, OptExecLast ) ) {
+            status->layout = LayoutExecLast;
+        }
+        else
+        if ( !strcmp( ptr, OptLayout ) ) {
+            char * layout = getOptionValue( argv, numArgs, &numOp, status );
+
+            for(status->layout = LayoutRes; status->layout < LayoutError; ++( status->layout )) {
+                if ( !strcmp( layout, LayoutNames[ status->layout ] ) ) {
+                    break;
+                }
+            }
+
+            if ( status->layout == LayoutError ) {
+                sprintf( status->msg, "invalid layout: '%s'", layout );
+                manageError( status->msg );
+            }
+        }
+        else
+        if ( !strcmp( ptr, OptAlign ) ) {
+            status->alignment = DefaultAlignment;
+
+            /* The alignment is optional, so it can only be given after '=' */
+            if ( value != NULL ) {
+                long alignment = atol( strchr( argv[ numOp ], '=' ) + 1 );
+
+                if ( alignment < 2
+                  || alignment % 2 )
+                {
+                    sprintf( status->msg, "invalid alignment: '%ld'", alignment );
+                    manageError( status->msg );
+                }
+
+                status->alignment = alignment;
+            }
+        }
+        else
+        if ( !strcmp( ptr, OptWindow ) ) {
+            char * size = getOptionValue( argv, numArgs, &numOp, status );
+
+            if ( sscanf( size, "%ux%u", &status->windowWidth, &status->windowHeight ) != 2
+              || status->windowWidth == 0
+              || status->windowHeight == 0 )
+            {
+                sprintf( status->msg, "invalid window size: '%s'", size );
+                manageError( status->msg );
+            }
+        }
+        else
+        if ( !strcmp( ptr, OptDescribe ) ) {
+            status->describe = true;
+        }
+        else
+        if ( !strcmp( ptr, OptDimensions ) ) {
+            status->dimensions = true;
+        }
+        else
+        if ( !strcmp( ptr, OptNoDedup ) ) {
+            status->dedup = false;
+        }
+        else
+        if ( !strcmp( ptr, OptList ) ) {
+            status->listBlorb = true;
+        }
+        else
+        if ( !strcmp( ptr, OptExtract ) ) {
+            status->extractUse = getOptionValue( argv, numArgs, &numOp, status );
+
+            if ( numOp + 1 < numArgs ) {
+                status->extractRes = argv[ ++numOp ];
+            } else {
+                sprintf( status->msg, "missing resource number for option: '%s'", OptExtract );
+                manageError( status->msg );
+            }
+        }
+        else
+        if ( !strcmp( ptr, OptStats ) ) {
+            status->statsFormat = StatsPlain;
+
+            /* The format is optional, so it can only be given after '=' */
+            if ( value != NULL ) {
+                value = strchr( argv[ numOp ], '=' ) + 1;
+
+                if ( !strcmp( value, StatsJson ) ) {
+                    status->statsFormat = StatsJsonFormat;
+                }
+                else
+                if ( strcmp( value, StatsText ) ) {
+                    sprintf( status->msg, "invalid format for statistics: '%s'", value );
+                    manageError( status->msg );
+                }
+            }
+        }
+        else
+        if ( !strcmp( ptr, OptStatsFile ) ) {
+            status->statsName = getOptionValue( argv, numArgs, &numOp, status );
+
+            if ( status->statsFormat == StatsNone ) {
+                status->statsFormat = StatsPlain;
+            }
+        }
+        else
+        if ( !strcmp( ptr, OptUpdateExec ) ) {
+            status->updateExec = getOptionValue( argv, numArgs, &numOp, status );
+        }
+        else
+        if ( !strcmp( ptr, OptBatch ) ) {
+            status->batchName = getOptionValue( argv, numArgs, &numOp, status );
+        }
+        else
+        if ( !strcmp( ptr, OptWatch ) ) {
+            status->watch = true;
+        }
+        else
+        if ( !strcmp( ptr, OptReproducible ) ) {
+            status->reproducible = true;
+        }
+        else
+        if ( !strcmp( ptr, OptDeps ) ) {
+            status->deps = true;
+        }
+        else
+        if ( !strcmp( ptr, OptDepFile ) ) {
+            status->depName = getOptionValue( argv, numArgs, &numOp, status );
+            status->deps = true;
+        }
+        else
+        if ( !strcmp( ptr, OptDevMap ) ) {
+            status->devMap = true;
+        }
+        else {
+            sprintf( status->msg, "invalid option: '%s'", ptr );
+            manageError( status->msg );
+        }
+
+        /* Remove the option (and its value) from the count of arguments */
+        *argc -= numOp - firstOp + 1;
+
+        free( op );
+        op  = NULL;
+        ptr = NULL;
+    }
+
+    return numOp;
+}
+
+inline
+const char * getAppName()
+{
+    return AppName;
+}
+
+/**
+ * chooseLogStream decides where messages go to.
+ * If the blorb file is written to the standard output,
+ * then messages are sent to the standard error stream.
+ */
+void chooseLogStream(int argc, char * argv[], Status * status)
+{
+    if ( argc > 2
+      && !strcmp( argv[ argc - 1 ], StdOutName ) )
+    {
+        status->log = stderr;
+    }
+}
+
+inline
+void decideApp(Status * status)
+{
+    if ( !strcmp( status->myName, BresApp ) ) {
+        status->onlyBli = true;
+        status->noBli = false;
+    }
+    else
+    if ( !strcmp( status->myName, BlcApp ) ) {
+        status->onlyBli = false;
+        status->noBli = true;
+        status->isShortExtension = true;
+    }
+    else
+    if ( strcmp( status->myName, BrescApp ) ) {
+        manageError( "Unsupported functionality" );
+    }
+}
+
+/**
+ * fprintMakeName writes a file name to a dependency file,
+ * escaping the characters which are special for make
+ */
+void fprintMakeName(FILE * f, const char * name)
+{
+    for(; *name != 0; ++name) {
+        if ( *name == ' '
+          || *name == '#' )
+        {
+            fputc( '\\', f );
+        }
+        else
+        if ( *name == '$' ) {
+            fputc( '$', f );
+        }
+
+        fputc( *name, f );
+    }
+}
+
+/**
+ * cmpChunksByFileName compares two chunks (given by pointers) by file name,
+ * and then by position in the blorb, for qsort
+ */
+int cmpChunksByFileName(const void * a, const void * b)
+{
+    const Chunk * chunk1 = *( (const Chunk **) a );
+    const Chunk * chunk2 = *( (const Chunk **) b );
+    int toret = strcmp( chunk1->FileName, chunk2->FileName );
+
+    if ( toret == 0 ) {
+        toret = ( chunk1 > chunk2 ) - ( chunk1 < chunk2 );
+    }
+
+    return toret;
+}
+
+/**
+ * writeDepFile writes a dependency file for make (as with -MD in gcc),
+ * named after the output file unless given:
+ * the blorb and the bli file depend on the res file, the story file,
+ * the bibliographic info, the cover and all pictures and sounds.
+ * A file used by more than one resource (say, the cover and a picture)
+ * is listed only once, in the order of the blorb.
+ */
+void writeDepFile(Status * status)
+{
+    int i;
+    int n = 0;
+    FILE * f;
+    Chunk ** sorted;
+    bool * listed;
+
+    if ( status->depName == NULL ) {
+        status->depName = changeFileNameExt( &status->arena,
+                                             strcmp( status->outName, StdOutName ) ? status->outName : status->inName,
+                                             DepFileExt );
+    }
+
+    f = fopen( status->depName, "wt" );
+
+    if ( f == NULL ) {
+        sprintf( status->msg, "can't open dependency file: '%s'", status->depName );
+        manageError( status->msg );
+    }
+
+    /* Targets */
+    if ( strcmp( status->outName, StdOutName ) ) {
+        fprintMakeName( f, status->outName );
+    }
+
+    if ( !status->noBli
+      && status->bliName != NULL )
+    {
+        fputc( ' ', f );
+        fprintMakeName( f, status->bliName );
+    }
+
+    /* Prerequisites: only the first resource of each file is listed */
+    sorted = (Chunk **) my_malloc( ( status->numberOfChunks + 1 ) * sizeof( Chunk * ) );
+    listed = (bool *) my_malloc( ( status->numberOfChunks + 1 ) * sizeof( bool ) );
+
+    for(i = 0; i < status->numberOfChunks; i++) {
+        listed[ i ] = false;
+
+        if ( status->BlorbChunks[ i ].FileName != NULL
+          && strcmp( status->BlorbChunks[ i ].FileName, status->inName ) )
+        {
+            sorted[ n++ ] = &( status->BlorbChunks[ i ] );
+        }
+    }
+
+    qsort( sorted, n, sizeof( Chunk * ), cmpChunksByFileName );
+
+    for(i = 0; i < n; i++) {
+        if ( i == 0
+          || strcmp( sorted[ i ]->FileName, sorted[ i - 1 ]->FileName ) )
+        {
+            listed[ sorted[ i ] - status->BlorbChunks ] = true;
+        }
+    }
+
+    fprintf( f, ": \\\n  " );
+    fprintMakeName( f, status->inName );
+
+    for(i = 0; i < status->numberOfChunks; i++) {
+        if ( listed[ i ] ) {
+            fprintf( f, " \\\n  " );
+            fprintMakeName( f, status->BlorbChunks[ i ].FileName );
+        }
+    }
+
+    fprintf( f, "\n" );
+    fclose( f );
+    free( listed );
+    free( sorted );
+}
+
+/**
+ * writeResourceMap writes a resource map instead of a blorb (--dev-map),
+ * for interpreters able to load resources from their files.
+ * After the signature, there is a line for each resource in the index:
+ * its use, number, type, size and absolute file name.
+ * The name of the map is the output file, or the res file with extension .map
+ */
+void writeResourceMap(Status * status)
+{
+    int i;
+    FILE * f;
+
+    if ( status->outName == NULL ) {
+        status->outName = changeFileNameExt( &status->arena, status->inName, DevMapExt );
+    }
+
+    if ( !strcmp( status->outName, StdOutName ) ) {
+        f = stdout;
+    }
+    else f = fopen( status->outName, "wt" );
+
+    if ( f == NULL ) {
+        sprintf( status->msg, "can't open resource map: '%s'", status->outName );
+        manageError( status->msg );
+    }
+
+    fprintf( f, "%s %d\n", DevMapSignature, DevMapVersion );
+
+    for(i = 0; i < status->numberOfChunks; i++) {
+        Chunk * chunk = &( status->BlorbChunks[ i ] );
+
+        if ( chunk->FileName != NULL
+          && strcmp( chunk->Use, "0" ) )
+        {
+            fprintf( f, "%s %u %s %lu %s\n",
+                     chunk->Use, chunk->Res, chunk->Type, chunk->Length,
+                     getAbsolutePath( &status->arena, chunk->FileName )
+            );
+        }
+    }
+
+    fflush( f );
+    status->bytesWritten += ftell( f );
+
+    if ( f != stdout ) {
+        fclose( f );
+    }
+}
+
+/**
+ * buildProject builds the blorb and the .bli file of the res file in status->inName.
+ * The blorb is written to status->outName or, if it is NULL,
+ * to a file named after the res file.
+ */
+void buildProject(Status * status)
+{
+    /* Show status */
+    if ( status->verbose ) {
+        fprintf( status->log, "\nCreate .bli file: %s\tGenerate .blorb: %s\tShort ext.: %s\n",
+                    ( !status->noBli ) ? "Yes" : "No",
+                    ( !status->onlyBli ) ? "Yes" : "No",
+                    ( status->isShortExtension ) ? "Yes" : "No"
+        );
+    }
+
+    /* Open entry file */
+    if ( status->verbose ) {
+        fprintf( status->log, "\nOpening files..." );
+    }
+
+    status->path = getPathFromFileName( &status->arena, status->inName );
+    status->bliName = changeFileNameExt( &status->arena, status->inName, DefaultBliExt );
+    status->in  = fopen( status->inName,  "rb" );
+
+    if ( status->in == NULL ) {
+        sprintf( status->msg,
+                 "(before compilation): can't open Blorb Resources Control File:\n'%s'\n",
+                 status->inName
+        );
+        manageError( status->msg );
+    }
+
+    /* Read the .res file and build the index */
+    fprintf( status->log, "\nProcessing '%s'...\n", status->inName );
+    buildIndex( status );
+    if ( status->verbose ) {
+        fprintf( status->log, "\n\tIndex built...\n" );
+        reportChunks( status, false );
+    }
+
+
+    /* Generate blorb, or only point to the resource files */
+    if ( status->devMap ) {
+        writeResourceMap( status );
+        remove( getManifestName( status ) );
+    }
+    else
+    if ( !status->onlyBli ) {
+        /* Open output blb file */
+        changeOutputFileExtension( status );
+
+        if ( status->incremental
+          && prepareIncremental( status ) )
+        {
+            fprintf( status->log, "\t'%s' is up to date.\n", status->outName );
+        } else {
+            if ( !strcmp( status->outName, StdOutName ) ) {
+                status->out = stdout;
+            }
+            else
+            if ( status->tempName != NULL ) {
+                status->out = fopen( status->tempName, "wb" );
+            }
+            else status->out = fopen( status->outName, "wb" );
+
+            if ( status->out == NULL ) {
+                sprintf( status->msg, "(before compilation): can't open Blorb Output File:\n'%s'\n",
+                        status->outName
+                );
+                manageError( status->msg );
+            }
+
+            /* do it */
+            startPhase( status, PhaseWrite );
+            generateBlorb( status );
+            endPhase( status, PhaseWrite );
+
+            if ( status->incremental ) {
+                finishIncremental( status );
+            }
+            else
+            if ( strcmp( status->outName, StdOutName ) ) {
+                /* The manifest of a previous incremental build is no longer valid */
+                remove( getManifestName( status ) );
+            }
+
+            if ( status->verbose ) {
+                fprintf( status->log, "\tChunks written...\n" );
+                reportChunks( status, true );
+            }
+        }
+    } else {
+        status->outName = status->bliName;
+        status->bliName = NULL;
+    }
+
+    if ( status->deps ) {
+        writeDepFile( status );
+    }
+
+    fprintf( status->log, "End ('%s').\n", status->outName );
+
+    if ( status->statsFormat != StatsNone ) {
+        writeStats( status );
+    }
+}
+
+/**
+ * addBatchJob adds a project to the list of projects to build in batch mode
+ * @param status The status, for the arena and error messages
+ * @param jobs The list of projects, growing as needed
+ * @param numJobs The number of projects in the list
+ * @param inName The res file of the project
+ * @param outName The output file, or NULL for the name of the res file
+ */
+void addBatchJob(Status * status, BatchJob ** jobs, int * numJobs, const char * inName, const char * outName)
+{
+    BatchJob * job;
+
+    if ( outName != NULL
+      && !strcmp( outName, StdOutName ) )
+    {
+        sprintf( status->msg, "projects can't be written to the standard output in batch mode: '%s'", inName );
+        manageError( status->msg );
+    }
+
+    *jobs = (BatchJob *) my_realloc( *jobs, ( ( *numJobs ) + 1 ) * sizeof( BatchJob ) );
+    job = &( *jobs )[ ( *numJobs )++ ];
+
+    job->InName = changeFileNameExt( &status->arena, inName, DefaultInExt );
+    job->OutName = ( outName != NULL ) ? arenaStrdup( &status->arena, outName ) : NULL;
+    job->Pid = 0;
+    job->ExitCode = job->Signal = 0;
+    job->Wall = 0;
+}
+
+/**
+ * readBatchFile reads the projects listed in status->batchName:
+ * one per line, the res file optionally followed by the output file.
+ * Empty lines, and lines starting with '#', are skipped.
+ */
+void readBatchFile(Status * status, BatchJob ** jobs, int * numJobs)
+{
+    char line[ BufferSize ];
+    char * inName;
+    char * outName;
+    FILE * f = fopen( status->batchName, "rt" );
+
+    if ( f == NULL ) {
+        sprintf( status->msg, "can't open batch file: '%s'", status->batchName );
+        manageError( status->msg );
+    }
+
+    while ( fgets( line, BufferSize, f ) != NULL ) {
+        line[ strcspn( line, LineDelimiters ) ] = 0;
+        inName = line + strspn( line, FieldDelimiters );
+
+        if ( *inName == 0
+          || *inName == BatchComment )
+        {
+            continue;
+        }
+
+        /* The output file is the rest of the line, if any */
+        outName = inName + strcspn( inName, FieldDelimiters );
+
+        if ( *outName != 0 ) {
+            *( outName++ ) = 0;
+            outName += strspn( outName, FieldDelimiters );
+        }
+
+        addBatchJob( status, jobs, numJobs, inName,
+                     ( *outName != 0 ) ? strTrim( outName, FieldDelimiters ) : NULL );
+    }
+
+    fclose( f );
+}
+
+/**
+ * isBatch decides whether the arguments are several res files,
+ * instead of a res file and its output file
+ */
+bool isBatch(Status * status, char *args[], int numArgs)
+{
+    return ( numArgs > 2
+          || ( numArgs == 2
+            && !strcmp( strtolower( getFileNameExt( &status->arena, args[ 1 ] ) ), DefaultInExt ) ) );
+}
+
+/**
+ * buildBatchJob builds a project in its own worker process, and ends it.
+ * Errors in the project end the worker through manageError, not the batch.
+ */
+void buildBatchJob(Status * status, BatchJob * job)
+{
+    status->inName = job->InName;
+    status->outName = job->OutName;
+
+    if ( status->statsFormat != StatsNone ) {
+        status->statsName = changeFileNameExt( &status->arena, job->InName, BatchStatsExt );
+    }
+
+    buildProject( status );
+    cleanMemory( status );
+    exit( EXIT_SUCCESS );
+}
+
+/**
+ * runBatch builds the projects listed in the batch file and in the arguments.
+ * Each project is built by its own process, so an error only stops that project,
+ * with at most status->jobs processes at the same time.
+ * Projects sharing resources share their reads through the page cache.
+ * @param status The status
+ * @param args The res files given as arguments
+ * @param numArgs The number of res files given as arguments
+ * @return true if all projects were built, false otherwise
+ */
+bool runBatch(Status * status, char *args[], int numArgs)
+{
+    BatchJob * jobs = NULL;
+    int numJobs = 0;
+    int failed = 0;
+    int i;
+
+    if ( status->statsName != NULL ) {
+        sprintf( status->msg, "the statistics of each project are written to its .%s file in batch mode, "
+                              "'--%s' can't be used",
+                 BatchStatsExt, OptStatsFile
+        );
+        manageError( status->msg );
+    }
+
+    if ( status->batchName != NULL ) {
+        readBatchFile( status, &jobs, &numJobs );
+    }
+
+    for(i = 0; i < numArgs; i++) {
+        addBatchJob( status, &jobs, &numJobs, args[ i ], NULL );
+    }
+
+    if ( numJobs == 0 ) {
+        sprintf( status->msg, "no projects to build in batch file: '%s'", status->batchName );
+        manageError( status->msg );
+    }
+
+#ifdef HAVE_THREADS
+    {
+        int numWorkers = ( (int) status->jobs < numJobs ) ? (int) status->jobs : numJobs;
+        int running = 0;
+        int next = 0;
+        int result;
+        double start = getWallTime();
+        BatchJob * job;
+        pid_t pid;
+
+        /* The threads for loading resources are shared among the workers */
+        status->jobs /= numWorkers;
+
+        fprintf( status->log, "\nBuilding %d projects, %d at a time...\n", numJobs, numWorkers );
+
+        while ( next < numJobs
+             || running > 0 )
+        {
+            /* Start projects while there are free workers */
+            while ( next < numJobs
+                 && running < numWorkers )
+            {
+                job = &jobs[ next++ ];
+
+                /* Buffered output must not be written by both processes */
+                fflush( status->log );
+                fflush( stderr );
+
+                pid = fork();
+
+                if ( pid == 0 ) {
+                    buildBatchJob( status, job );
+                }
+
+                if ( pid < 0 ) {
+                    sprintf( status->msg, "can't start the build of: '%s'", job->InName );
+                    manageWarning( status->msg );
+                    job->ExitCode = EXIT_FAILURE;
+                    continue;
+                }
+
+                job->Pid = pid;
+                job->Wall = getWallTime();
+                ++running;
+            }
+
+            /* Wait for any project to finish */
+            if ( running > 0 ) {
+                pid = wait( &result );
+
+                if ( pid < 0 ) {
+                    break;
+                }
+
+                for(i = 0; i < next && jobs[ i ].Pid != pid; i++);
+
+                if ( i < next ) {
+                    job = &jobs[ i ];
+                    job->Wall = getWallTime() - job->Wall;
+
+                    if ( WIFEXITED( result ) ) {
+                        job->ExitCode = WEXITSTATUS( result );
+                    } else {
+                        job->ExitCode = -1;
+                        job->Signal = WIFSIGNALED( result ) ? WTERMSIG( result ) : 0;
+                    }
+
+                    --running;
+                }
+            }
+        }
+
+        /* Report */
+        for(i = 0; i < numJobs; i++) {
+            if ( jobs[ i ].ExitCode != 0 ) {
+                ++failed;
+            }
+        }
+
+        fprintf( status->log, "\nBatch: %d projects, %d built, %d failed (%.3f s).\n",
+                 numJobs, numJobs - failed, failed, getWallTime() - start );
+
+        for(i = 0; i < numJobs; i++) {
+            job = &jobs[ i ];
+
+            fprintf( status->log, "\t%-6s %8.3f s\t%s",
+                     ( job->ExitCode == 0 ) ? "ok" : "FAILED", job->Wall, job->InName );
+
+            if ( job->ExitCode > 0 ) {
+                fprintf( status->log, " (exit code %d)", job->ExitCode );
+            }
+            else
+            if ( job->ExitCode < 0 ) {
+                fprintf( status->log, " (signal %d)", job->Signal );
+            }
+
+            fprintf( status->log, "\n" );
+        }
+    }
+#else
+    sprintf( status->msg, "batch builds are not available in this platform" );
+    manageError( status->msg );
+#endif
+
+    free( jobs );
+    return ( failed == 0 );
+}
+
+#ifdef HAVE_INOTIFY
+/**
+ * addWatchedFile adds a file to the files watched in watch mode,
+ * watching its directory at once, if it was not already watched
+ * @param list The list of watched files
+ * @param fileName The name of the file
+ */
+void addWatchedFile(WatchList * list, const char * fileName)
+{
+    WatchedFile * file;
+
+    if ( list->numFiles == list->maxFiles ) {
+        list->maxFiles = ( list->maxFiles + 1 ) * 2;
+        list->files = (WatchedFile *) my_realloc( list->files,
+                                                  list->maxFiles * sizeof( WatchedFile ) );
     }
-
-    /* Now, scroll through the chunks, noting each one in the index chunk */
-    dp = status->BlorbChunks[ 0 ]->Data + 4;
-    for(i = 1; i < status->numberOfChunks; i++) {
-        if ( status->verbose ) {
-            strcat( status->report, "\t\t" );
-            strcat( status->report, describeChunk( status->BlorbChunks[ i ], status, true ) );
-            strcat( status->report, "\n" );
-        }
-
-        if ( strcmp( status->BlorbChunks[ i ]->Use, "0" ) != 0 )
-        {
-            strId( dp, status->BlorbChunks[ i ]->Use );
-            dp += 4;
-            strLong( dp, status->BlorbChunks[ i ]->Res );
-            dp += 4;
-            status->indexOffsets[ status->numberOfIndexEntries++ ] =
-                    ( dp -( status->BlorbChunks[0]->Data ) ) + 20
-            ;
-            dp += 4;
-        }
-    }
-}
+
+    file = &( list->files[ ( list->numFiles )++ ] );
+    file->Dir = getPathFromFileName( &list->arena, fileName );
+    file->Name = arenaStrdup( &list->arena, fileName + strlen( file->Dir ) );
+    file->Wd = inotify_add_watch( list->fd, ( *file->Dir != 0 ) ? file->Dir : ".",
+                                  IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE );
+}
 
 /**
- * writeChunk writes one chunk to a file
- */
-void writeChunk(FILE * out, Chunk * chunk)
-/* AIFF files are themselves chunks, so we just write their data, not
- * their other info.
- */
-{
-    int z = 0;
-
-    if ( strcmp( chunk->Type, "FORM" ) ) {
-         writeId ( out, chunk->Type );
-         writeInt( out, chunk->Length );
+ * buildWatched builds the project in a child process, so errors do not end
+ * the watcher. The child reports the files of the project through a pipe,
+ * once the res file is parsed, and they replace the watched files: they are
+ * watched while the rest of the build goes on.
+ * If the res file can't be parsed, the watched files are kept.
+ * @return true if the project was built, false otherwise
+ */
+bool buildWatched(Status * status, WatchList * list)
+{
+    char line[ BufferSize ];
+    bool isFirst = true;
+    double start = getWallTime();
+    int result = -1;
+    int fds[ 2 ];
+    FILE * f;
+    pid_t pid;
+
+    if ( pipe( fds ) != 0 ) {
+        manageError( "can't communicate with the build in watch mode" );
     }
-
-    fwrite( chunk->Data, 1, chunk->Length, out);
 
-    /* Pad chunks of odd length */
-    if ( chunk->Length % 2 ) {
-        fwrite( &z, 1, 1, out);
-    }
-}
+    /* Buffered output must not be written by both processes */
+    fflush( status->log );
+    fflush( stderr );
 
-/** generateBlorb generates a blorb from a res file. Requires the index to be already built
- * @see buildIndex
- * @param in res file handle
- * @param out destination file handle
- */
-void generateBlorb(Status * status)
-{
-    long int n = 0;
-    int i;
-
-    /* Prepare report, if needed */
-    if ( status->verbose
-      && status->report == NULL )
-    {
-        initReport( status );
+    pid = fork();
+
+    if ( pid == 0 ) {
+        close( fds[ 0 ] );
+        status->watchFd = fds[ 1 ];
+        buildProject( status );
+        cleanMemory( status );
+        exit( EXIT_SUCCESS );
     }
-
-    /* Write the IFF header */
-    writeId( status->out, "FORM" );
-    writeId( status->out, "latr" );  /* We'll find this out at the end */
-    writeId( status->out, "IFRS" );
-
-    /* The index should be already built */
-    for(i = 0; i < status->numberOfChunks; i++) {
-        /* Prepare report */
-        if ( status->verbose ) {
-            char aux[ShortStringSize];
-            sprintf( aux, "\t\tChunk %04d(%s)\twritten.\n",
-                     i + 1,
-                     describeChunk( status->BlorbChunks[ i ], status, false )
-            );
-            strcat( status->report, aux );
-        }
-
-        /* Write the index entries into the index chunk */
-        if ( strcmp( status->BlorbChunks[ i ]->Use, "0" ) ) {
-            /* Prepare the offsets */
-            long int t = ftell( status->out );
-            fseek( status->out, status->indexOffsets[ n++ ], SEEK_SET );
-            writeInt( status->out, t );
-            fseek( status->out, t, SEEK_SET);
+
+    close( fds[ 1 ] );
+
+    if ( pid < 0 ) {
+        close( fds[ 0 ] );
+        sprintf( status->msg, "can't start the build of: '%s'", status->inName );
+        manageWarning( status->msg );
+        return false;
+    }
+
+    /* Read the files of the project, one per line */
+    f = fdopen( fds[ 0 ], "r" );
+
+    while ( fgets( line, BufferSize, f ) != NULL ) {
+        line[ strcspn( line, LineDelimiters ) ] = 0;
+
+        if ( isFirst ) {
+            arenaRelease( &list->arena );
+            list->numFiles = 0;
+            isFirst = false;
         }
-
-        /* Write the chunk to the file */
-        writeChunk( status->out, status->BlorbChunks[ i ] );
+
+        addWatchedFile( list, line );
     }
-
-    /* Size of the data section of the blorb file */
-    n = ftell( status->out ) - 8;
-    fseek( status->out, 4, SEEK_SET );
-
-    /* Write that to the file */
-    writeInt( status->out, n );
-}
-
-void changeOutputFileExtension(Status * status)
-{
-    if ( !status->isShortExtension ) {
-        if ( status->thereIsBib ) {
-            if ( status->isGlulx )
-                    status->outFileExt = BlorbGlulxExt;
-            else    status->outFileExt = BlorbZCodeExt;
-        }
-        else
-        if ( !status->isGlulx ) {
-            status->outFileExt = BlorbZCodeExt;
-        }
-    }
-
-    status->outName = changeFileNameExt( status->inName, status->outFileExt );
-}
-
-void cleanMemory(Status * status)
-{
-    int i;
-
-    /* Clean memory */
-    free( status->indexOffsets );
-    status->indexOffsets = NULL;
-    status->myName = NULL;
-    status->path = NULL;
-
-    for(i = 0; i < status->numberOfChunks; i++) {
-        if ( status->BlorbChunks[ i ] != NULL ) {
-            free( status->BlorbChunks[ i ]->Data );
-            status->BlorbChunks[ i ]->Data = NULL;
-            free( status->BlorbChunks[ i ] );
-            status->BlorbChunks[ i ] = NULL;
-        }
-    }
-
-    status->numberOfChunks = 0;
-
-    free( status->outName );
-    free( status->inName );
-    free( status->bliName );
-    free( status->report );
-    status->outName = status->inName = status->report = status->bliName = NULL;
-
-    /* Close files */
-    if ( status->in != NULL ) {
-        fclose( status->in );
-    }
-
-    if ( status->out != NULL ) {
-        fclose( status->out );
-    }
-
-    if ( status->bli != NULL ) {
-        fclose( status->bli );
-    }
-}
 
-void strUsage(Status * status)
-{
-    sprintf( status->msg, "Usage is :\n"
-                    "\t%s [options] in-file\n\n\tOptions:\n"
-                    "\t\t--%s     \tShows this help and ends.\n"
-                    "\t\t--%s\tShows version and ends.\n"
-                    "\t\t--%s  \tPrevents .bli file of being generated.\n"
-                    "\t\t--%s\tIt does only generate the .bli file, no blorb.\n"
-                    "\t\t--%s\tIt does only generate files with .blb extension.\n"
-                    ,
-                    status->myName,
-                    OptHelp, OptVersion, OptNoBli, OptBliOnly, OptShortExt
-    );
+    fclose( f );
+    waitpid( pid, &result, 0 );
+
+    if ( WIFEXITED( result )
+      && WEXITSTATUS( result ) == EXIT_SUCCESS )
+    {
+        fprintf( status->log, "Built in %.3f s.\n", getWallTime() - start );
+        return true;
+    }
+
+    fprintf( status->log, "Build failed.\n" );
+    return false;
 }
 
-unsigned int processOptions(char *argv[], int * argc, Status *status, bool *end)
+/**
+ * waitForChanges blocks until a watched file is written, moved or deleted.
+ * The directories of the files are watched, since editors often save files
+ * by replacing them. Changes made during the last build are pending,
+ * so they are found at once. Then, it waits for a moment without changes,
+ * so that a group of changes is built only once.
+ */
+void waitForChanges(Status * status, WatchList * list)
 {
-    unsigned int numOp = 1;
-    char * op;
+    long buffer[ BufferSize / sizeof( long ) ];
+    const struct inotify_event * event;
+    struct pollfd pollFd;
+    bool changed = false;
     char * ptr;
+    ssize_t length;
+    int i;
 
-    for(; numOp < (*argc); ++numOp ) {
-        op = my_strdup( argv[ numOp ] );
-        strtolower( op );
-        ptr = op;
+    fprintf( status->log, "\nWatching %d files for changes...\n", list->numFiles );
+    fflush( status->log );
 
-        /* Pass all '-' */
-        while ( *ptr == '-' ) {
-            ++ptr;
-        }
+    while ( !changed ) {
+        length = read( list->fd, buffer, sizeof( buffer ) );
 
-        /* Was any '-' present? */
-        if ( ptr == op ) {
-            free( op );
-            break;
+        if ( length <= 0 ) {
+            manageError( "can't watch the files of the project" );
         }
 
-        /* Check options */
-        if ( !strcmp( ptr, OptNoBli ) ) {
-            status->noBli = true;
-            --(*argc);
-        }
-        else
-        if ( !strcmp( ptr, OptVersion ) ) {
-            printf( "\n\n" );
+        for(ptr = (char *) buffer; ptr < (char *) buffer + length; ptr += sizeof( *event ) + event->len) {
+            event = (const struct inotify_event *) ptr;
 
-            *end = true;
-            --(*argc);
+            for(i = 0; i < list->numFiles; i++) {
+                WatchedFile * file = &( list->files[ i ] );
+
+                if ( event->len > 0
+                  && file->Wd == event->wd
+                  && !strcmp( file->Name, event->name ) )
+                {
+                    fprintf( status->log, "\nChanged: '%s%s'\n", file->Dir, file->Name );
+                    changed = true;
+                    break;
+                }
+            }
         }
-        else
-        if ( !strcmp( ptr, OptHelp ) ) {
-            strUsage( status );
-            printf( "\n%s\n", status->msg );
+    }
 
-            *end = true;
-            --(*argc);
-        }
-        else
-        if ( !strcmp( ptr, OptBliOnly ) ) {
-            status->onlyBli = true;
-            --(*argc);
-        }
-        else
-        if ( !strcmp( ptr, OptVerbose ) ) {
-            status->verbose = true;
-            --(*argc);
-        }
-        else
-        if ( !strcmp( ptr, OptShortExt ) ) {
-            status->isShortExtension = true;
-            --(*argc);
-        }
-        else {
-            sprintf( status->msg, "invalid option: '%s'", ptr );
-            manageError( status->msg );
-        }
+    /* Let the rest of the changes happen */
+    pollFd.fd = list->fd;
+    pollFd.events = POLLIN;
 
+    while ( poll( &pollFd, 1, WatchDelay ) > 0
+         && read( list->fd, buffer, sizeof( buffer ) ) > 0 );
+}
+#endif
 
-        free( op );
-        op  = NULL;
-        ptr = NULL;
+/**
+ * watchProject builds the project, and then builds it again each time
+ * the res file or any of its resources change, until interrupted.
+ * Rebuilds are incremental: only changed resources are read again.
+ */
+void watchProject(Status * status)
+{
+#ifdef HAVE_INOTIFY
+    WatchList list;
+
+    if ( status->outName != NULL
+      && !strcmp( status->outName, StdOutName ) )
+    {
+        manageError( "the standard output can't be used in watch mode" );
     }
 
-    return numOp;
-}
-
-inline
-const char * getAppName()
-{
-    return AppName;
-}
-
-inline
-void decideApp(Status * status)
-{
-    if ( !strcmp( status->myName, BresApp ) ) {
-        status->onlyBli = true;
-        status->noBli = false;
-    }
-    else
-    if ( !strcmp( status->myName, BlcApp ) ) {
-        status->onlyBli = false;
-        status->noBli = true;
-        status->isShortExtension = true;
-    }
-    else
-    if ( strcmp( status->myName, BrescApp ) ) {
-        manageError( "Unsupported functionality" );
-    }
+    arenaInit( &list.arena );
+    list.files = NULL;
+    list.numFiles = list.maxFiles = 0;
+    list.fd = inotify_init();
+
+    if ( list.fd < 0 ) {
+        manageError( "can't watch the files of the project" );
+    }
+
+    /* The res file is watched from the start, and its resources once it is parsed */
+    addWatchedFile( &list, status->inName );
+
+    if ( !status->onlyBli
+      && !status->devMap )
+    {
+        status->incremental = true;
+    }
+
+    for(;;) {
+        buildWatched( status, &list );
+        waitForChanges( status, &list );
+    }
+#else
+    sprintf( status->msg, "watch mode is not available in this platform" );
+    manageError( status->msg );
+#endif
 }
-
+
 int main(int argc, char **argv)
 {
     bool finish = false;
     unsigned int numOp = 1;
     Status status;
+    int toret = EXIT_SUCCESS;
 
     /* Init vbles */
     initStatus( argv, &status );
+    chooseLogStream( argc, argv, &status );
 
     /* Welcome */
-    printf( InfoMsg, status.myName, Version, AppName );
+    fprintf( status.log, InfoMsg, status.myName, Version, AppName );
 
     /* Process options.
        "-version" and "-help" mean to finish the program immediately */
@@ -1254,106 +4636,75 @@ int main(int argc, char **argv)
     decideApp( &status );
 
     /* Print error usage */
-    if ( argc < 2 )
+    if ( argc < 2
+      && ( status.batchName == NULL
+        || status.updateExec != NULL
+        || status.listBlorb
+        || status.extractUse != NULL ) )
     {
         strUsage( &status );
         manageError( status.msg );
     }
     else
+    /* Update the executable of an existing blorb file */
+    if ( status.updateExec != NULL )
+    {
+        status.outName = argv[ numOp ];
+        updateExec( &status );
+        fprintf( status.log, "End ('%s').\n", status.outName );
+        goto End;
+    }
+    else
+    /* Inspect an existing blorb file */
+    if ( status.listBlorb
+      || status.extractUse != NULL )
+    {
+        status.inName = argv[ numOp ];
+
+        if ( status.listBlorb ) {
+            listBlorb( &status );
+        }
+
+        if ( status.extractUse != NULL ) {
+            if ( argc > 2 ) {
+                status.outName = argv[ numOp + 1 ];
+            }
+
+            extractChunk( &status );
+        }
+
+        goto End;
+    }
+    else
+    /* Several projects: build them in parallel */
+    if ( status.batchName != NULL
+      || isBatch( &status, argv + numOp, argc - 1 ) )
+    {
+        if ( !runBatch( &status, argv + numOp, argc - 1 ) ) {
+            toret = EXIT_FAILURE;
+        }
+
+        goto End;
+    }
+    else
     /* 1 argument: use input res file as reference for output file */
     if ( argc == 2 )
     {
-        char * inName2;
-
-        status.inName = my_strdup( argv[ numOp ] );
-        inName2 = changeFileNameExt( status.inName, DefaultInExt );
-        free( status.inName );
-        status.inName = inName2;
+        status.inName = changeFileNameExt( &status.arena, argv[ numOp ], DefaultInExt );
     }
     /* two arguments: input: res file output: user-specified file */
     else
     {
-        char * name  = my_strdup( argv[ numOp ] );
-
-        status.inName  = changeFileNameExt( name, DefaultInExt );
-        status.outName = my_strdup( argv[ numOp + 1 ] );
+        status.inName  = changeFileNameExt( &status.arena, argv[ numOp ], DefaultInExt );
+        status.outName = argv[ numOp + 1 ];
     }
 
-    /* Show status */
-    if ( status.verbose ) {
-        printf( "\nCreate .bli file: %s\tGenerate .blorb: %s\tShort ext.: %s\n",
-                    ( !status.noBli ) ? "Yes" : "No",
-                    ( !status.onlyBli ) ? "Yes" : "No",
-                    ( status.isShortExtension ) ? "Yes" : "No"
-        );
+    if ( status.watch ) {
+        watchProject( &status );
     }
-
-    /* Open entry file */
-    if ( status.verbose ) {
-        printf( "\nOpening files..." );
-    }
-
-    status.path = getPathFromFileName( status.inName );
-    status.bliName = changeFileNameExt( status.inName, DefaultBliExt );
-    status.in  = fopen( status.inName,  "rt" );
-
-    if ( status.in == NULL ) {
-        sprintf( status.msg,
-                 "(before compilation): can't open Blorb Resources Control File:\n'%s'\n",
-                 status.inName
-        );
-        manageError( status.msg );
-    }
-
-    if ( !status.noBli ) {
-        status.bli = fopen( status.bliName, "wt" );
-        if ( status.bli == NULL ) {
-            sprintf( status.msg,
-                 "(before compilation): can't open Blorb Resources Control File:\n'%s'\n",
-                 status.inName
-            );
-            manageError( status.msg );
-        }
-    }
-
-    /* Read the .res file and build the index */
-    printf( "\nProcessing '%s'...\n", status.inName );
-    buildIndex( &status );
-    if ( status.verbose ) {
-        printf( "\n\tIndex built...\n" );
-        printf( "%s\n", status.report );
-        *( status.report ) = 0;
-    }
-
-
-    /* Generate blorb */
-    if ( !status.onlyBli ) {
-        /* Open output blb file */
-        changeOutputFileExtension( &status );
-        status.out = fopen( status.outName, "wb" );
-        if ( status.out == NULL ) {
-            sprintf( status.msg, "(before compilation): can't open Blorb Output File:\n'%s'\n",
-                    status.outName
-            );
-            manageError( status.msg );
-        }
-
-        /* do it */
-        generateBlorb( &status );
-
-        if ( status.verbose ) {
-            printf( "\tChunks written...\n" );
-            printf( "%s\n", status.report );
-        }
-    } else {
-        free( status.outName );
-        status.outName = status.bliName;
-        status.bliName = NULL;
-    }
-
-    printf( "End ('%s').\n", status.outName );
+    else buildProject( &status );
 
     End:
     cleanMemory( &status );
-    return EXIT_SUCCESS;
+    return toret;
 }
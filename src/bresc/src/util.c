@@ -1,10 +1,46 @@
 /* util.c */
 
+#ifdef __linux__
+#  define _GNU_SOURCE
+#endif
+
 #include "util.h"
 
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
+
+#ifdef _WIN32
+#  include <io.h>
+#else
+#  include <unistd.h>
+#  include <sys/time.h>
+#  include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#  include <errno.h>
+#  include <sys/mman.h>
+#  include <sys/sendfile.h>
+#  if defined( __GLIBC__ ) \
+   && ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 27 ) )
+#    define HAVE_COPY_FILE_RANGE
+#  endif
+#endif
+
+/** Size of the blocks used when copying files */
+#define CopyBlockSize 65536
+
+/** Minimum size of the blocks of memory in arenas */
+#define ArenaBlockSize 65536
+
+/** Alignment of the memory allocated from arenas */
+#define ArenaAlignment 16
+
+/** Parameters of the 64bit FNV-1a hash function */
+#define FnvOffsetBasis 0xcbf29ce484222325ULL
+#define FnvPrime       0x100000001b3ULL
 
 /** Delimiters between fields */
 const char * FieldDelimiters = " \t";
@@ -43,9 +79,86 @@ void *my_malloc(size_t size)
         manageError( "my_malloc(): not enough memory" );
     }
 
-    memset( buf, 0, size );
+    return buf;
+}
 
-    return buf;
+/** A block of memory in an arena. Allocated memory follows the header. */
+typedef struct _ArenaBlock {
+    struct _ArenaBlock * next;
+    size_t size;
+    size_t used;
+} ArenaBlock;
+
+/** Size of the header of the blocks, keeping alignment */
+#define ArenaHeaderSize \
+    ( ( sizeof( ArenaBlock ) + ArenaAlignment - 1 ) & ~( ArenaAlignment - 1 ) )
+
+void arenaInit(Arena * arena)
+{
+    arena->blocks = NULL;
+}
+
+void *arenaAlloc(Arena * arena, size_t size)
+{
+    ArenaBlock * block = arena->blocks;
+    void * toret;
+
+    size = ( size + ArenaAlignment - 1 ) & ~( ArenaAlignment - 1 );
+
+    /* Need a new block? */
+    if ( block == NULL
+      || block->size - block->used < size )
+    {
+        size_t blockSize = ArenaBlockSize;
+
+        if ( blockSize < size ) {
+            blockSize = size;
+        }
+
+        block = (ArenaBlock *) my_malloc( ArenaHeaderSize + blockSize );
+        block->size = blockSize;
+        block->used = 0;
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    toret = ( (char *) block ) + ArenaHeaderSize + block->used;
+    block->used += size;
+
+    return toret;
+}
+
+char *arenaStrdup(Arena * arena, const char * str)
+{
+    const size_t len = strlen( str ) + 1;
+
+    return memcpy( arenaAlloc( arena, len ), str, len );
+}
+
+void arenaRelease(Arena * arena)
+{
+    ArenaBlock * block = arena->blocks;
+    ArenaBlock * next;
+
+    while ( block != NULL ) {
+        next = block->next;
+        free( block );
+        block = next;
+    }
+
+    arena->blocks = NULL;
+}
+
+/**
+    allocIn() - allocates memory from an arena, or with my_malloc if it is NULL
+*/
+static void *allocIn(Arena * arena, size_t size)
+{
+    if ( arena != NULL ) {
+        return arenaAlloc( arena, size );
+    }
+
+    return my_malloc( size );
 }
 
 void *my_strdup(const char * str)
@@ -59,7 +172,7 @@ void *my_strdup(const char * str)
     return toret;
 }
 
-char *getShortFileName(const char * fileName)
+char *getShortFileName(Arena * arena, const char * fileName)
 {
     const unsigned int len = strlen( fileName );
     const char * ptr = fileName + len - 1;
@@ -99,101 +212,182 @@ char *getShortFileName(const char * fileName)
 
     /* Create new string (if needed) */
     neededLen = dotPos - slashPos - 1;
-    toret = (char *) malloc( neededLen + 1 );
+    toret = (char *) allocIn( arena, neededLen + 1 );
 
-    memset( toret, 0, neededLen + 1 );
     memcpy( toret, slashPos + 1, neededLen );
+    toret[ neededLen ] = 0;
 
     return toret;
 }
 
-char *changeFileNameExt(char * fileName, const char * ext)
+/**
+    findExtDot() - finds the dot before the extension of a file name,
+                   ignoring the dots in the names of directories
+    @param fileName the file name as string
+    @return a pointer to the dot, or NULL if there is no extension
+*/
+static const char * findExtDot(const char * fileName)
 {
-    const unsigned int fileNameLen = strlen( fileName );
-    const unsigned int extLen = strlen( ext );
-    const unsigned int maxLen = fileNameLen + extLen;
-    char * toret = (char *) my_malloc( maxLen );
-    char * ptr = fileName + fileNameLen - 1;
-    char * dotPos = NULL;
+    const char * ptr = fileName + strlen( fileName ) - 1;
 
-    /* Look for dot */
-    while( ptr >= fileName ) {
+    while( ptr >= fileName
+        && *ptr != '/'
+        && *ptr != '\\' )
+    {
         if ( *ptr == '.' ) {
-            dotPos = ptr;
-            break;
+            return ptr;
         }
         --ptr;
     }
 
+    return NULL;
+}
+
+char *changeFileNameExt(Arena * arena, const char * fileName, const char * ext)
+{
+    const unsigned int fileNameLen = strlen( fileName );
+    const char * dotPos = findExtDot( fileName );
+    unsigned int baseLen;
+    char * toret;
+
     if ( dotPos == NULL ) {
         dotPos = fileName + fileNameLen;
-        memcpy( toret, fileName, dotPos - fileName + 1 );
-        strcat( toret, "." );
-    } else {
-        /* Copy until dot */
-        memcpy( toret, fileName, dotPos - fileName + 1 );
-        *( toret + ( dotPos - fileName ) + 1 ) = 0;
     }
 
     if ( *ext == '.' ) {
             ++ext;
     }
 
-    /* Append extension */
-    strcat( toret, ext );
+    /* Copy until dot, then the dot and the extension */
+    baseLen = dotPos - fileName;
+    toret = (char *) allocIn( arena, baseLen + strlen( ext ) + 2 );
+    memcpy( toret, fileName, baseLen );
+    toret[ baseLen ] = '.';
+    strcpy( toret + baseLen + 1, ext );
 
     return toret;
 }
 
-char * getFileNameExt(const char * fileName)
+char * getFileNameExt(Arena * arena, const char * fileName)
 {
-    const unsigned int fileNameLen = strlen( fileName );
-    unsigned int extLen;
-    char * toret = (char *) my_malloc( fileNameLen );
-    const char * ptr = fileName + fileNameLen - 1;
-    const char * dotPos = NULL;
-
-    /* Look for dot */
-    while( ptr >= fileName ) {
-        if ( *ptr == '.' ) {
-            dotPos = ptr;
-            break;
-        }
-        --ptr;
-    }
+    const char * dotPos = findExtDot( fileName );
+    char * toret;
 
     if ( dotPos == NULL ) {
+        toret = (char *) allocIn( arena, 1 );
         *toret = 0;
     } else {
         /* Copy after dot */
-        extLen = dotPos - fileName + 2;
-        memcpy( toret, dotPos + 1, extLen );
-        *( toret + extLen ) = 0;
+        toret = (char *) allocIn( arena, strlen( dotPos ) );
+        strcpy( toret, dotPos + 1 );
         strTrim( toret, FieldDelimiters );
     }
 
     return toret;
 }
 
-void skipDelimiters(FILE * f)
+void outBufferInit(OutBuffer * out, FILE * f, size_t capacity)
 {
-    int c = fgetc( f );
+    out->f = f;
+    out->buffer = (unsigned char *) my_malloc( capacity );
+    out->length = 0;
+    out->capacity = capacity;
+    out->error = false;
+}
 
-    while ( ( strchr( FieldDelimiters, c ) != NULL
-           || strchr( LineDelimiters, c ) != NULL )
-         && c != EOF )
-    {
-        c = fgetc( f );
+/**
+    outBufferDrain() - writes all pending bytes to the file, without flushing it
+*/
+static void outBufferDrain(OutBuffer * out)
+{
+    if ( out->length > 0 ) {
+        if ( fwrite( out->buffer, 1, out->length, out->f ) != out->length ) {
+            out->error = true;
+        }
+
+        out->length = 0;
+    }
+}
+
+void outBufferWrite(OutBuffer * out, const void * data, size_t length)
+{
+    if ( out->capacity - out->length < length ) {
+        outBufferDrain( out );
+
+        if ( length > out->capacity ) {
+            if ( fwrite( data, 1, length, out->f ) != length ) {
+                out->error = true;
+            }
+
+            return;
+        }
     }
 
-    if ( c != EOF ) {
-        ungetc( c, f );
+    memcpy( out->buffer + out->length, data, length );
+    out->length += length;
+}
+
+void outBufferWriteInt(OutBuffer * out, unsigned long v)
+{
+    unsigned char * ptr;
+
+    if ( out->capacity - out->length < 4 ) {
+        outBufferDrain( out );
     }
 
-    return;
+    ptr = out->buffer + out->length;
+    ptr[ 0 ] = ( v >> 24 ) & 0xFF;
+    ptr[ 1 ] = ( v >> 16 ) & 0xFF;
+    ptr[ 2 ] = ( v >> 8 ) & 0xFF;
+    ptr[ 3 ] = v & 0xFF;
+    out->length += 4;
 }
 
-char * getPathFromFileName(const char * fileName)
+void outBufferWriteId(OutBuffer * out, const char * id)
+{
+    unsigned char * ptr;
+    int i;
+
+    if ( out->capacity - out->length < 4 ) {
+        outBufferDrain( out );
+    }
+
+    ptr = out->buffer + out->length;
+
+    for(i = 0; i < 4 && id[ i ] != 0; ++i) {
+        ptr[ i ] = id[ i ];
+    }
+
+    for(; i < 4; ++i) {
+        ptr[ i ] = ' ';
+    }
+
+    out->length += 4;
+}
+
+bool outBufferFlush(OutBuffer * out)
+{
+    outBufferDrain( out );
+
+    if ( fflush( out->f ) != 0 ) {
+        out->error = true;
+    }
+
+    return !out->error;
+}
+
+bool outBufferRelease(OutBuffer * out)
+{
+    bool toret = outBufferFlush( out );
+
+    free( out->buffer );
+    out->buffer = NULL;
+    out->capacity = 0;
+
+    return toret;
+}
+
+char * getPathFromFileName(Arena * arena, const char * fileName)
 {
     /* Look for directory mark & extension mark */
     const unsigned int fileNameLen = strlen( fileName );
@@ -212,17 +406,17 @@ char * getPathFromFileName(const char * fileName)
     }
 
     resultingLen = ptr - fileName + 1;
-    toret = my_malloc( resultingLen + 1 );
+    toret = allocIn( arena, resultingLen + 1 );
     memcpy( toret, fileName, resultingLen );
     *( toret + resultingLen ) = 0;
 
     return toret;
 }
 
-char * makeCompletePath(const char * path, const char * fileName)
+char * makeCompletePath(Arena * arena, const char * path, const char * fileName)
 {
     const unsigned int neededLen = strlen( path ) +  strlen( fileName ) + 1;
-    char * toret = my_malloc( neededLen );
+    char * toret = allocIn( arena, neededLen );
 
     strcpy( toret, path );
     strcat( toret, fileName );
@@ -230,6 +424,27 @@ char * makeCompletePath(const char * path, const char * fileName)
     return toret;
 }
 
+char * getAbsolutePath(Arena * arena, const char * fileName)
+{
+#ifdef _WIN32
+    char * absolute = _fullpath( NULL, fileName, 0 );
+#else
+    char * absolute = realpath( fileName, NULL );
+#endif
+    char * toret;
+
+    if ( absolute == NULL ) {
+        toret = allocIn( arena, strlen( fileName ) + 1 );
+        strcpy( toret, fileName );
+    } else {
+        toret = allocIn( arena, strlen( absolute ) + 1 );
+        strcpy( toret, absolute );
+        free( absolute );
+    }
+
+    return toret;
+}
+
 char * freadLine(FILE * f, char ** buffer, unsigned int * buflen, const char * delimiters)
 {
     unsigned int current = 0;
@@ -266,16 +481,235 @@ char * freadLine(FILE * f, char ** buffer, unsigned int * buflen, const char * d
     return *buffer;
 }
 
-char * freadBlock(FILE * f, size_t offset, size_t length)
+#ifdef __linux__
+/**
+    zeroCopy() - copies bytes between file descriptors without passing them
+    through user space. It tries copy_file_range(), then sendfile(), and
+    finally mmap() + write().
+    @param outFd output file descriptor, positioned where data must be written
+    @param inFd input file descriptor
+    @param offset The position in inFd to copy from
+    @param length Number of bytes to copy
+    @return the number of bytes actually copied
+*/
+static size_t zeroCopy(int outFd, int inFd, size_t offset, size_t length)
+{
+    size_t done = 0;
+    ssize_t copied = 0;
+    off_t inOffset = offset;
+    off_t mapOffset;
+    size_t mapDelta;
+    char * map;
+
+#ifdef HAVE_COPY_FILE_RANGE
+    loff_t rangeOffset = offset;
+
+    while ( done < length ) {
+        copied = copy_file_range( inFd, &rangeOffset, outFd, NULL, length - done, 0 );
+
+        if ( copied <= 0 ) {
+            break;
+        }
+
+        done += copied;
+    }
+
+    inOffset = offset + done;
+#endif
+
+    /* sendfile() can write to any kind of file, i.e. pipes */
+    while ( done < length ) {
+        copied = sendfile( outFd, inFd, &inOffset, length - done );
+
+        if ( copied <= 0 ) {
+            break;
+        }
+
+        done += copied;
+    }
+
+    /* Last resort: map the file and write it in one go */
+    if ( done < length ) {
+        mapOffset = offset & ~( (off_t) sysconf( _SC_PAGESIZE ) - 1 );
+        mapDelta = offset - mapOffset;
+        map = mmap( NULL, length + mapDelta, PROT_READ, MAP_PRIVATE, inFd, mapOffset );
+
+        if ( map != MAP_FAILED ) {
+            while ( done < length ) {
+                copied = write( outFd, map + mapDelta + done, length - done );
+
+                if ( copied < 0
+                  && errno == EINTR )
+                {
+                    continue;
+                }
+
+                if ( copied <= 0 ) {
+                    break;
+                }
+
+                done += copied;
+            }
+
+            munmap( map, length + mapDelta );
+        }
+    }
+
+    return done;
+}
+#endif
+
+bool fcopyBlock(FILE * out, FILE * in, size_t offset, size_t length)
+{
+    static char buffer[ CopyBlockSize ];
+    size_t blockLength;
+    bool toret = true;
+
+#ifdef __linux__
+    /* Copy in kernel space; what is left (if anything) is copied below */
+    if ( length > 0
+      && fflush( out ) == 0 )
+    {
+        size_t done = zeroCopy( fileno( out ), fileno( in ), offset, length );
+
+        offset += done;
+        length -= done;
+    }
+#endif
+
+    if ( length > 0 ) {
+        toret = ( fseeko( in, offset, SEEK_SET ) == 0 );
+    }
+
+    while ( toret
+         && length > 0 )
+    {
+        blockLength = length;
+
+        if ( blockLength > CopyBlockSize ) {
+            blockLength = CopyBlockSize;
+        }
+
+        toret = ( fread( buffer, 1, blockLength, in ) == blockLength
+               && fwrite( buffer, 1, blockLength, out ) == blockLength );
+        length -= blockLength;
+    }
+
+    return toret;
+}
+
+bool fcopyFile(FILE * out, const char * fileName, size_t length)
+{
+    FILE * in = fopen( fileName, "rb" );
+    bool toret = ( in != NULL );
+
+    if ( in != NULL ) {
+        toret = fcopyBlock( out, in, 0, length );
+        fclose( in );
+    }
+
+    return toret;
+}
+
+bool fmoveBlock(FILE * f, size_t from, size_t to, size_t length)
 {
-    char * toret = my_malloc( length );
-    size_t readLength;
+    static char buffer[ CopyBlockSize ];
+    size_t blockLength;
+    bool toret = true;
 
-    fseek( f, offset, SEEK_SET );
-    readLength = fread( toret, 1, length, f );
+    while ( toret
+         && length > 0 )
+    {
+        blockLength = length;
+
+        if ( blockLength > CopyBlockSize ) {
+            blockLength = CopyBlockSize;
+        }
+
+        toret = ( fseeko( f, from, SEEK_SET ) == 0
+               && fread( buffer, 1, blockLength, f ) == blockLength
+               && fseeko( f, to, SEEK_SET ) == 0
+               && fwrite( buffer, 1, blockLength, f ) == blockLength );
+
+        from += blockLength;
+        to += blockLength;
+        length -= blockLength;
+    }
+
+    return ( toret && fflush( f ) == 0 );
+}
+
+bool ftruncateFile(FILE * f, size_t length)
+{
+    if ( fflush( f ) != 0 ) {
+        return false;
+    }
+
+#ifdef _WIN32
+    return ( _chsize( _fileno( f ), length ) == 0 );
+#else
+    return ( ftruncate( fileno( f ), length ) == 0 );
+#endif
+}
+
+bool fhashFile(const char * fileName, unsigned long long * hash)
+{
+    FILE * in = fopen( fileName, "rb" );
+    unsigned char * buffer;
+    unsigned long long h = FnvOffsetBasis;
+    size_t blockLength;
+    size_t i;
+
+    if ( in == NULL ) {
+        return false;
+    }
+
+    buffer = (unsigned char *) my_malloc( CopyBlockSize );
+
+    while ( ( blockLength = fread( buffer, 1, CopyBlockSize, in ) ) > 0 ) {
+        for(i = 0; i < blockLength; ++i) {
+            h = ( h ^ buffer[ i ] ) * FnvPrime;
+        }
+    }
+
+    *hash = h;
+    free( buffer );
+    fclose( in );
+    return true;
+}
+
+bool fcmpFiles(const char * fileName1, const char * fileName2)
+{
+    FILE * in1 = fopen( fileName1, "rb" );
+    FILE * in2 = fopen( fileName2, "rb" );
+    unsigned char * buffer1 = NULL;
+    unsigned char * buffer2 = NULL;
+    size_t blockLength1;
+    size_t blockLength2;
+    bool toret = ( in1 != NULL && in2 != NULL );
+
+    if ( toret ) {
+        buffer1 = (unsigned char *) my_malloc( CopyBlockSize );
+        buffer2 = (unsigned char *) my_malloc( CopyBlockSize );
+
+        do {
+            blockLength1 = fread( buffer1, 1, CopyBlockSize, in1 );
+            blockLength2 = fread( buffer2, 1, CopyBlockSize, in2 );
+
+            toret = ( blockLength1 == blockLength2
+                   && !memcmp( buffer1, buffer2, blockLength1 ) );
+        } while( toret && blockLength1 > 0 );
+    }
+
+    free( buffer1 );
+    free( buffer2 );
 
-    if ( readLength != length ) {
-        manageError( "reading file" );
+    if ( in1 != NULL ) {
+        fclose( in1 );
+    }
+
+    if ( in2 != NULL ) {
+        fclose( in2 );
     }
 
     return toret;
@@ -301,6 +735,17 @@ char * strtolower(char *s)
     }
 
     return s;
+}
+
+bool strEqualNoCase(const char *s1, const char *s2)
+{
+    for(; *s1 != 0; ++s1, ++s2) {
+        if ( toupper( (unsigned char) *s1 ) != toupper( (unsigned char) *s2 ) ) {
+            return false;
+        }
+    }
+
+    return ( *s2 == 0 );
 }
 
 bool isRelativePath(char * fileName)
@@ -369,3 +814,40 @@ char * strTrim(char *s, const char * delimiters)
 
     return s;
 }
+
+double getWallTime()
+{
+#if defined( CLOCK_MONOTONIC ) && !defined( _WIN32 )
+    struct timespec now;
+
+    if ( clock_gettime( CLOCK_MONOTONIC, &now ) == 0 ) {
+        return now.tv_sec + ( now.tv_nsec / 1e9 );
+    }
+#endif
+
+    return (double) time( NULL );
+}
+
+double getCpuTime()
+{
+    return ( (double) clock() ) / CLOCKS_PER_SEC;
+}
+
+unsigned long getPeakMemory()
+{
+    unsigned long toret = 0;
+
+#ifndef _WIN32
+    struct rusage usage;
+
+    if ( getrusage( RUSAGE_SELF, &usage ) == 0 ) {
+        toret = usage.ru_maxrss;
+#  ifdef __APPLE__
+        /* Reported in bytes */
+        toret /= 1024;
+#  endif
+    }
+#endif
+
+    return toret;
+}
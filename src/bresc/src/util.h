@@ -1,7 +1,22 @@
 /* util.h */
 
+/* Offsets of 64 bits, so files over 2 GiB can be read on 32-bit systems too */
+#ifndef _FILE_OFFSET_BITS
+#  define _FILE_OFFSET_BITS 64
+#endif
+
+/* POSIX functions (fseeko, fileno, fdopen...) are declared even with -std=c99 */
+#ifndef _XOPEN_SOURCE
+#  define _XOPEN_SOURCE 700
+#endif
+
 #include <stdio.h>
 #include <stdbool.h>
+
+#ifdef _WIN32
+#  define fseeko _fseeki64
+#  define ftello _ftelli64
+#endif
 
 /** Delimiters between fields */
 extern const char * FieldDelimiters;
@@ -11,6 +26,46 @@ extern const char * LineDelimiters;
 
 extern const char * getAppName();
 
+/** A block of memory owned by an arena */
+struct _ArenaBlock;
+
+/**
+    Arena - a bump allocator. Memory allocated from an arena is never
+    freed individually: all of it is released at once with arenaRelease().
+*/
+typedef struct _Arena {
+    struct _ArenaBlock * blocks;
+} Arena;
+
+/**
+    arenaInit() - prepares an empty arena
+    @param arena The arena to initialize
+*/
+void arenaInit(Arena * arena);
+
+/**
+    arenaAlloc() - allocates memory from an arena. Memory is not zeroed.
+                   calls manageError if there is not enough memory
+    @param arena The arena to allocate from
+    @param size Size of memory
+    @return the new memory, which must not be free'd
+*/
+void *arenaAlloc(Arena * arena, size_t size);
+
+/**
+    arenaStrdup() - copies a string into an arena
+    @param arena The arena to allocate from
+    @param str string to copy
+    @return the new string, which must not be free'd
+*/
+char *arenaStrdup(Arena * arena, const char * str);
+
+/**
+    arenaRelease() - frees all the memory allocated from an arena
+    @param arena The arena to release. It is left empty, ready to be reused.
+*/
+void arenaRelease(Arena * arena);
+
 /**
     my_realloc() - reallocates memory. calls manageError if there is not enough memory
     @see manageError
@@ -22,7 +77,8 @@ extern const char * getAppName();
 void *my_realloc(void *buf, size_t size);
 
 /**
-    my_malloc() - allocates memory. calls manageError if there is not enough memory
+    my_malloc() - allocates memory. Memory is not zeroed.
+                  calls manageError if there is not enough memory
     @see manageError
     @param size New size of memory
     @return the new memory
@@ -54,58 +110,129 @@ void manageError(char * msg);
 void manageWarning(char * msg);
 
 
+/*
+  All functions returning new strings take an arena as first parameter.
+  If it is NULL, the string is allocated with my_malloc(), and must be freed.
+*/
+
 /**
   getShortFileName() - (strips directory and extension from file name)
-  @return simple file name (must be freed)
+  @return simple file name (must be freed if arena is NULL)
+  @param arena the arena to allocate from, or NULL
   @param fileName the file name as string
 */
 
-char *getShortFileName(const char * fileName);
+char *getShortFileName(Arena * arena, const char * fileName);
 
 /**
   changeFileNameExt() - (changes extension from file name).
-  Returns a new string which should be free'd.
-  @return a new file name (must be freed)
+  @return a new file name (must be freed if arena is NULL)
+  @param arena the arena to allocate from, or NULL
   @param fileName the file name as string
   @param ext a string with the new extension
 */
 
-char *changeFileNameExt(char *fileName, const char *ext);
+char *changeFileNameExt(Arena * arena, const char *fileName, const char *ext);
 
 /**
   getFileNameExt() - (gets extension from file name).
-  Returns a new string which should be free'd.
-  @return a new extension, of the file name (must be freed)
+  @return a new extension, of the file name (must be freed if arena is NULL)
+  @param arena the arena to allocate from, or NULL
   @param fileName the file name as string
 */
 
-char *getFileNameExt(const char *fileName);
+char *getFileNameExt(Arena * arena, const char *fileName);
 
 /**
-  skipDelimiters() - (skips '\n', ' ', and '\t').
-  @param f File name handle
-*/
+    OutBuffer - an output buffer over a file, with explicit flush control.
+    Small writes (i.e. chunk headers) are gathered in memory, and
+    reach the file in big blocks.
+*/
+typedef struct _OutBuffer {
+    FILE * f;
+    unsigned char * buffer;
+    size_t length;
+    size_t capacity;
+    bool error;
+} OutBuffer;
+
+/**
+    outBufferInit() - prepares an output buffer for a file
+    @param out The output buffer
+    @param f The file to write to
+    @param capacity The size of the buffer
+*/
+void outBufferInit(OutBuffer * out, FILE * f, size_t capacity);
+
+/**
+    outBufferWrite() - writes a block of bytes. Blocks bigger than
+                       the buffer are written directly to the file.
+    @param out The output buffer
+    @param data The bytes to write
+    @param length Number of bytes to write
+*/
+void outBufferWrite(OutBuffer * out, const void * data, size_t length);
+
+/**
+    outBufferWriteInt() - writes a 32bit big endian integer
+    @param out The output buffer
+    @param v The number to write
+*/
+void outBufferWriteInt(OutBuffer * out, unsigned long v);
+
+/**
+    outBufferWriteId() - writes a 4 chars identifier, space padded
+    @param out The output buffer
+    @param id The identifier to write
+*/
+void outBufferWriteId(OutBuffer * out, const char * id);
+
+/**
+    outBufferFlush() - writes all pending bytes to the file, and flushes it,
+                       so the file can be written directly afterwards
+    @param out The output buffer
+    @return true if everything was written so far, false otherwise
+*/
+bool outBufferFlush(OutBuffer * out);
 
-void skipDelimiters(FILE * f);
+/**
+    outBufferRelease() - flushes the output buffer and frees its memory
+    @param out The output buffer
+    @return true if everything was written, false otherwise
+*/
+bool outBufferRelease(OutBuffer * out);
 
 /**
   makeCompletePath() - returns a new string with the path and the file name concat.
+  @param arena the arena to allocate from, or NULL
   @param fileName The file name as string
   @param path The path as string
   @return A new string with the path and the filename concatenated.
-          Should be free'd.
+          Should be free'd if arena is NULL.
 */
 
-char * makeCompletePath(const char * path, const char * fileName);
+char * makeCompletePath(Arena * arena, const char * path, const char * fileName);
+
+/**
+  getAbsolutePath() - returns a new string with the absolute path of a file,
+  without symbolic links, "." or "..".
+  @param arena the arena to allocate from, or NULL
+  @param fileName The file name as string. The file must exist.
+  @return A new string with the absolute path, or a copy of fileName if it can't be found.
+          Should be free'd if arena is NULL.
+*/
+
+char * getAbsolutePath(Arena * arena, const char * fileName);
 
 /**
   getPathFromFileName() - returns a new string with the path from that file name.
+  @param arena the arena to allocate from, or NULL
   @param fileName The file name as string
-  @return A new string with the path extracted. Should be free'd.
+  @return A new string with the path extracted. Should be free'd if arena is NULL.
           A final slash is always present, unless there is no path.
 */
 
-char * getPathFromFileName(const char * fileName);
+char * getPathFromFileName(Arena * arena, const char * fileName);
 
 
 /**
@@ -121,14 +248,85 @@ char * getPathFromFileName(const char * fileName);
 char * freadLine(FILE * f, char ** buffer, unsigned int * buflen, const char * delimiters);
 
 /**
-    freadBlock() - reads a binary block from file f
-    @param f input file
-    @param offset The offset ot the file to read from
-    @param length Number of bytes to read
-    @return memoeyr buffer (to be free'd) with the contents of the file
+    fcopyBlock() - copies a block of a file to another one, in blocks of bounded size.
+                   On Linux, data is copied in kernel space (copy_file_range(),
+                   sendfile() or mmap()), with the block copy only as a fallback.
+                   The output stream is flushed before copying.
+    @param out output file
+    @param in input file
+    @param offset The position in the input file to copy from
+    @param length Number of bytes to copy
+    @return true if all bytes were copied, false otherwise
+
+*/
+bool fcopyBlock(FILE * out, FILE * in, size_t offset, size_t length);
+
+/**
+    fcopyFile() - copies the contents of a file to another one
+    @see fcopyBlock
+    @param out output file
+    @param fileName The name of the file to copy from
+    @param length Number of bytes to copy
+    @return true if all bytes were copied, false otherwise
+
+*/
+bool fcopyFile(FILE * out, const char * fileName, size_t length);
+
+/**
+    fmoveBlock() - moves a block of a file to a lower position in the same file
+    @param f The file, opened for reading and writing
+    @param from The current position of the block
+    @param to The new position of the block. Must be lower than from.
+    @param length Number of bytes to move
+    @return true if all bytes were moved, false otherwise
+
+*/
+bool fmoveBlock(FILE * f, size_t from, size_t to, size_t length);
+
+/**
+    ftruncateFile() - sets the length of a file, discarding all bytes after it
+    @param f The file, opened for writing
+    @param length The new length of the file
+    @return true if the file could be truncated, false otherwise
 
 */
-char * freadBlock(FILE * f, size_t offset, size_t length);
+bool ftruncateFile(FILE * f, size_t length);
+
+/**
+    fhashFile() - computes a (non cryptographic) 64bit hash of the contents of a file
+    @param fileName The name of the file
+    @param hash Where the hash is stored
+    @return true if the file could be read, false otherwise
+
+*/
+bool fhashFile(const char * fileName, unsigned long long * hash);
+
+/**
+    fcmpFiles() - compares the contents of two files, byte by byte
+    @param fileName1 The name of the first file
+    @param fileName2 The name of the second file
+    @return true if both files could be read, and their contents are the same
+*/
+bool fcmpFiles(const char * fileName1, const char * fileName2);
+
+/**
+    getWallTime() - returns the time elapsed since an arbitrary point, in seconds,
+                    from a monotonic clock, if available
+    @return the time, in seconds
+*/
+double getWallTime();
+
+/**
+    getCpuTime() - returns the processor time used by the program, in seconds
+    @return the time, in seconds
+*/
+double getCpuTime();
+
+/**
+    getPeakMemory() - returns the maximum resident set size of the program
+    @return the size, in kilobytes, or 0 if it is not known in this system
+*/
+unsigned long getPeakMemory();
 
 /**
  * strtoupper() converts a string to uppercase
@@ -144,6 +342,14 @@ char * strtoupper(char *s);
  */
 char * strtolower(char *s);
 
+/**
+ * strEqualNoCase() compares two strings, ignoring case
+ * @param s1 The first string
+ * @param s2 The second string
+ * @return true if they are equal, but for case. False otherwise.
+ */
+bool strEqualNoCase(const char *s1, const char *s2);
+
 /**
  * strTrim() converts a string, removing leading and trailing spaces
  * @param s The string to convert. Must be writable.
@@ -0,0 +1,95 @@
+#! /bin/sh
+
+#===============================================================================
+# Test of --align: builds synthetic projects (see bench/genproject.pl) with
+# several alignments, and opens each blorb again with --list, which reads it
+# with blorbOpenFile(). The index (RIdx) must be the first chunk, at offset 12,
+# and the data of every large chunk must start at a multiple of the alignment.
+# --update-exec must warn when it moves aligned chunks.
+#
+# Usage: align.sh [-b bresc] [-w work-dir]
+#-------------------------------------------------------------------------------
+
+test_location=`dirname "$0"`
+bresc=
+work_dir=
+
+while getopts "b:w:" op; do
+	case $op in
+		b) bresc=$OPTARG;;
+		w) work_dir=$OPTARG;;
+		*) sed -n 's/^# Usage: /Usage: /p' "$0" >&2; exit 1;;
+	esac
+done
+
+if [ -z "$bresc" ] || [ ! -x "$bresc" ]; then
+	echo "bresc not found: '$bresc' (give the binary to test with -b)" >&2
+	exit 1
+fi
+
+if [ -z "$work_dir" ]; then
+	work_dir=`mktemp -d "${TMPDIR:-/tmp}/bresc-test.XXXXXX"` || exit 1
+	trap 'rm -rf "$work_dir"' 0
+fi
+
+failures=0
+
+# check_blorb blorb alignment: the blorb opens, and its chunks are aligned
+check_blorb() {
+	if ! "$bresc" --list "$1" > "$work_dir/list.txt" 2>&1; then
+		echo "FAILED: '$1' can't be opened" >&2
+		cat "$work_dir/list.txt" >&2
+		return 1
+	fi
+
+	if [ "`od -A n -t c -j 12 -N 4 "$1" | tr -d ' '`" != "RIdx" ]; then
+		echo "FAILED: the index of '$1' is not at offset 12" >&2
+		return 1
+	fi
+
+	# Use, res, offset, length, type: the data follows the chunk header,
+	# but for FORM chunks, which are written as they are
+	awk -v align="$2" '
+		$1 ~ /^(Exec|Pict|Snd|Data)$/ && $4 >= align {
+			data = ( $5 == "FORM" ) ? $3 : $3 + 8
+			if ( data % align != 0 ) {
+				print "FAILED: " $1 " " $2 " is at " $3 ", not aligned to " align
+				bad = 1
+			}
+		}
+		END { exit bad }' "$work_dir/list.txt" >&2
+}
+
+for n in 20 400; do
+	project=$work_dir/project-$n
+
+	perl "$test_location/../bench/genproject.pl" --max-size=65536 --cover "$n" "$project" > /dev/null || exit 1
+
+	for align in 64 512 4096; do
+		if ! "$bresc" --nobli --align="$align" "$project/game.res" "$project/game.gblorb" > "$work_dir/log.txt" 2>&1; then
+			echo "FAILED: build of $n resources with --align=$align" >&2
+			cat "$work_dir/log.txt" >&2
+			failures=`expr $failures + 1`
+		elif ! check_blorb "$project/game.gblorb" "$align"; then
+			failures=`expr $failures + 1`
+		fi
+	done
+done
+
+# Moving the aligned chunks after the executable is reported
+project=$work_dir/project-20
+cat "$project/game.ulx" "$project/game.ulx" > "$work_dir/longer.ulx"
+"$bresc" --nobli --align=512 "$project/game.res" "$project/game.gblorb" > /dev/null 2>&1
+
+if ! "$bresc" --update-exec "$work_dir/longer.ulx" "$project/game.gblorb" 2>&1 | grep -q "no longer aligned"; then
+	echo "FAILED: no warning when --update-exec moves aligned chunks" >&2
+	failures=`expr $failures + 1`
+fi
+
+if [ $failures -gt 0 ]; then
+	echo "$failures failed" >&2
+	exit 1
+fi
+
+echo "All passed"
+exit 0
@@ -0,0 +1,102 @@
+#! /bin/sh
+
+#===============================================================================
+# Test of --incremental: builds a synthetic project (see bench/genproject.pl)
+# incrementally after changes that must not be missed, and compares each
+# blorb with the one built from scratch, which must be byte for byte the same.
+#
+# Usage: incremental.sh [-b bresc] [-w work-dir]
+#-------------------------------------------------------------------------------
+
+test_location=`dirname "$0"`
+bresc=
+work_dir=
+
+while getopts "b:w:" op; do
+	case $op in
+		b) bresc=$OPTARG;;
+		w) work_dir=$OPTARG;;
+		*) sed -n 's/^# Usage: /Usage: /p' "$0" >&2; exit 1;;
+	esac
+done
+
+if [ -z "$bresc" ] || [ ! -x "$bresc" ]; then
+	echo "bresc not found: '$bresc' (give the binary to test with -b)" >&2
+	exit 1
+fi
+
+if [ -z "$work_dir" ]; then
+	work_dir=`mktemp -d "${TMPDIR:-/tmp}/bresc-test.XXXXXX"` || exit 1
+	trap 'rm -rf "$work_dir"' 0
+fi
+
+failures=0
+project=$work_dir/project
+
+# build [options]: builds the blorb of the project, with the options given
+build() {
+	if ! "$bresc" --nobli "$@" "$project/game.res" "$project/game.gblorb" > "$work_dir/log.txt" 2>&1; then
+		echo "FAILED: build with '$*'" >&2
+		cat "$work_dir/log.txt" >&2
+		failures=`expr $failures + 1`
+		return 1
+	fi
+}
+
+# check_blorb test: the incremental blorb is the one built from scratch
+check_blorb() {
+	"$bresc" --nobli "$project/game.res" "$work_dir/fresh.gblorb" > /dev/null 2>&1
+
+	if ! cmp -s "$project/game.gblorb" "$work_dir/fresh.gblorb"; then
+		echo "FAILED: $1" >&2
+		failures=`expr $failures + 1`
+	fi
+}
+
+# edit file text: overwrites the end of a file, keeping its size
+edit() {
+	size=`wc -c < "$1"`
+	printf "$2" | dd of="$1" bs=1 seek=`expr $size - 4` conv=notrunc 2> /dev/null
+}
+
+perl "$test_location/../bench/genproject.pl" --max-size=65536 50 "$project" > /dev/null || exit 1
+picture=$project/`awk '$1 == "Pict" { print $3; exit }' "$project/game.res"`
+
+# A blorb of the same size, built later without --incremental
+build --incremental
+build --layout=execlast
+
+if [ -f "$project/game.gblorb.manifest" ]; then
+	echo "FAILED: the manifest is kept by a build without --incremental" >&2
+	failures=`expr $failures + 1`
+fi
+
+build --incremental && check_blorb "rebuilt after a build without --incremental"
+
+# The same, with the manifest and the time of a previous build put back
+cp "$project/game.gblorb.manifest" "$work_dir/manifest"
+touch -r "$project/game.gblorb" "$work_dir/stamp"
+build --layout=execlast
+cp "$work_dir/manifest" "$project/game.gblorb.manifest"
+touch -r "$work_dir/stamp" "$project/game.gblorb"
+build --incremental && check_blorb "rebuilt with a stale manifest"
+
+# A file of the same size, changed right after a build
+build --incremental
+edit "$picture" "EDIT"
+build --incremental && check_blorb "rebuilt after a change right after a build"
+
+# The same, but keeping the time of the file, after the time of the manifest
+touch -t 203001010000 "$picture"
+build --incremental
+edit "$picture" "TIDE"
+touch -t 203001010000 "$picture"
+build --incremental && check_blorb "rebuilt after a change in the same time"
+
+if [ $failures -gt 0 ]; then
+	echo "$failures failed" >&2
+	exit 1
+fi
+
+echo "All passed"
+exit 0
@@ -0,0 +1,86 @@
+#! /bin/sh
+
+#===============================================================================
+# Test of file names: extensions are only looked for after the last path
+# separator, so a Data file without extension (Data nx ./noext) is described
+# as 'noext' in the .bli file, and a res file given without extension in a
+# directory with dots (dir.v/game) is found, and names the blorb.
+#
+# Usage: names.sh [-b bresc] [-w work-dir]
+#-------------------------------------------------------------------------------
+
+test_location=`dirname "$0"`
+bresc=
+work_dir=
+
+while getopts "b:w:" op; do
+	case $op in
+		b) bresc=$OPTARG;;
+		w) work_dir=$OPTARG;;
+		*) sed -n 's/^# Usage: /Usage: /p' "$0" >&2; exit 1;;
+	esac
+done
+
+if [ -z "$bresc" ] || [ ! -x "$bresc" ]; then
+	echo "bresc not found: '$bresc' (give the binary to test with -b)" >&2
+	exit 1
+fi
+
+case $bresc in
+	/*) ;;
+	*) bresc=`pwd`/$bresc;;
+esac
+
+if [ -z "$work_dir" ]; then
+	work_dir=`mktemp -d "${TMPDIR:-/tmp}/bresc-test.XXXXXX"` || exit 1
+	trap 'rm -rf "$work_dir"' 0
+fi
+
+failures=0
+project=$work_dir/project.v
+
+# fail message: reports a failure
+fail() {
+	echo "FAILED: $1" >&2
+	failures=`expr $failures + 1`
+}
+
+perl "$test_location/../bench/genproject.pl" 3 "$project" > /dev/null || exit 1
+
+mkdir -p "$project/tables.v"
+echo "A text without extension" > "$project/noext"
+echo "A text in a directory with a dot" > "$project/tables.v/plain"
+printf 'Data nx ./noext\nData plain tables.v/plain\n' >> "$project/game.res"
+
+cd "$project" || exit 1
+
+if ! "$bresc" game.res > "$work_dir/log.txt" 2>&1; then
+	fail "build with Data files without extension"
+	cat "$work_dir/log.txt" >&2
+else
+	grep -q "! Data: 'noext'\$" game.bli || fail "'./noext' is not described as 'noext'"
+	grep -q "! Data: 'plain'\$" game.bli || fail "'tables.v/plain' is not described as 'plain'"
+fi
+
+cd - > /dev/null
+
+# The res file, without extension, in a directory with a dot
+cd "$work_dir" || exit 1
+rm -f project.v/game.blb
+
+if ! "$bresc" --nobli project.v/game > "$work_dir/log.txt" 2>&1; then
+	fail "build of 'project.v/game'"
+	cat "$work_dir/log.txt" >&2
+elif [ ! -f project.v/game.blb ]; then
+	fail "the blorb of 'project.v/game' is not 'project.v/game.blb'"
+fi
+
+cd - > /dev/null
+
+if [ $failures -gt 0 ]; then
+	echo "$failures failed" >&2
+	exit 1
+fi
+
+echo "All passed"
+exit 0